@@ -17,6 +17,18 @@ class TConfigBase
     : public NRefCounted::TRefCountedBase
 {
 public:
+    TConfigBase() = default;
+
+    // Configs are plain values, so copies are fine: the reference counter
+    // lives outside the object and is not copied. Nested configs are shared.
+    TConfigBase(const TConfigBase&)
+        : TRefCountedBase()
+    { }
+
+    TConfigBase& operator=(const TConfigBase&) {
+        return *this;
+    }
+
     void LoadFromFile(const std::filesystem::path& filePath);
 
     virtual void Load(const nlohmann::json& data) = 0;
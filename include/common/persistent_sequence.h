@@ -0,0 +1,339 @@
+#pragma once
+
+#include <common/intrusive_ptr.h>
+#include <common/refcounted.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace NCommon {
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct TNoChunkSummary {
+    template <typename T>
+    void Add(const T&) { }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Persistent deque-like sequence built from fixed-size chunks.
+//
+// Copying a sequence is O(1): copies share chunks and the chunk index (spine).
+// Only the newest version may grow in place: appending writes into slots that
+// no other version can see, so older versions stay valid snapshots.
+// Appending to a version that is not the newest copies the affected chunk.
+// Popping from the front only moves the begin index, expired chunks are
+// retired when the spine is rebuilt and reused by later appends once no
+// version refers to them anymore, so a sequence of stable length stops
+// allocating after warmup.
+//
+// Mutations of different versions must be serialized by the caller, readers
+// of published versions need no synchronization with the writer.
+//
+// Every chunk keeps a TChunkSummary fed with its items (Add(const T&)), e.g.
+// a zone map. A full chunk is never written again, so its summary can be
+// read by any version that contains the whole chunk.
+template <typename T, size_t ChunkSize = 512, typename TChunkSummary = TNoChunkSummary>
+class TPersistentSequence {
+private:
+    struct TChunk
+        : public NRefCounted::TRefCountedBase
+    {
+        std::array<T, ChunkSize> Items;
+        // Number of filled slots over all versions, touched by the writer only.
+        size_t Used = 0;
+        [[no_unique_address]] TChunkSummary Summary;
+    };
+
+    using TChunkPtr = TIntrusivePtr<TChunk>;
+
+    struct TSpine
+        : public NRefCounted::TRefCountedBase
+    {
+        explicit TSpine(size_t capacity)
+            : Chunks(std::make_unique<TChunkPtr[]>(capacity)),
+              Capacity(capacity)
+        { }
+
+        std::unique_ptr<TChunkPtr[]> Chunks;
+        size_t Capacity;
+        size_t Used = 0;
+
+        // Expired chunks, possibly still read by older versions. Only the
+        // writer touches this list.
+        std::vector<TChunkPtr> Retired;
+    };
+
+    using TSpinePtr = TIntrusivePtr<TSpine>;
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = const T&;
+    using const_reference = const T&;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        const_iterator(const TPersistentSequence* sequence, size_t index)
+            : Sequence_(sequence), Index_(index)
+        { }
+
+        reference operator*() const { return (*Sequence_)[Index_]; }
+        pointer operator->() const { return &(*Sequence_)[Index_]; }
+        reference operator[](difference_type n) const { return (*Sequence_)[Index_ + n]; }
+
+        const_iterator& operator++() { ++Index_; return *this; }
+        const_iterator operator++(int) { auto copy = *this; ++Index_; return copy; }
+        const_iterator& operator--() { --Index_; return *this; }
+        const_iterator operator--(int) { auto copy = *this; --Index_; return copy; }
+
+        const_iterator& operator+=(difference_type n) { Index_ += n; return *this; }
+        const_iterator& operator-=(difference_type n) { Index_ -= n; return *this; }
+
+        friend const_iterator operator+(const_iterator it, difference_type n) { return it += n; }
+        friend const_iterator operator+(difference_type n, const_iterator it) { return it += n; }
+        friend const_iterator operator-(const_iterator it, difference_type n) { return it -= n; }
+
+        friend difference_type operator-(const const_iterator& lhs, const const_iterator& rhs) {
+            return static_cast<difference_type>(lhs.Index_) - static_cast<difference_type>(rhs.Index_);
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs.Index_ == rhs.Index_; }
+        friend auto operator<=>(const const_iterator& lhs, const const_iterator& rhs) { return lhs.Index_ <=> rhs.Index_; }
+
+        size_t Index() const { return Index_; }
+
+    private:
+        const TPersistentSequence* Sequence_ = nullptr;
+        size_t Index_ = 0;
+    };
+
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    TPersistentSequence() = default;
+
+    template <typename TContainer>
+    explicit TPersistentSequence(const TContainer& items) {
+        for (const auto& item : items) {
+            push_back(item);
+        }
+    }
+
+    size_t size() const { return End_ - Begin_; }
+    bool empty() const { return End_ == Begin_; }
+
+    const T& operator[](size_t index) const {
+        size_t position = Begin_ + index;
+        return Spine_->Chunks[position / ChunkSize]->Items[position % ChunkSize];
+    }
+
+    const T& front() const { return (*this)[0]; }
+    const T& back() const { return (*this)[size() - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    // Summary of the chunk holding item index if this version contains all
+    // of it, null otherwise. It may cover items popped from the front.
+    const TChunkSummary* GetChunkSummary(size_t index) const {
+        size_t chunkIndex = (Begin_ + index) / ChunkSize;
+        if ((chunkIndex + 1) * ChunkSize > End_) {
+            return nullptr;
+        }
+        return &Spine_->Chunks[chunkIndex]->Summary;
+    }
+
+    // Index one past the last item in the chunk holding item index.
+    size_t GetChunkEnd(size_t index) const {
+        size_t position = Begin_ + index;
+        return std::min(position - position % ChunkSize + ChunkSize, End_) - Begin_;
+    }
+
+    void push_back(const T& value) {
+        size_t chunkIndex = End_ / ChunkSize;
+        size_t slot = End_ % ChunkSize;
+
+        if (slot == 0) {
+            EnsureSpineSlot(chunkIndex);
+            // EnsureSpineSlot may rebase the positions.
+            chunkIndex = End_ / ChunkSize;
+            Spine_->Chunks[chunkIndex] = AllocateChunk();
+            Spine_->Used = chunkIndex + 1;
+        } else if (Spine_->Chunks[chunkIndex]->Used != slot || Spine_->Used != chunkIndex + 1) {
+            // Someone has already grown past this version, do not clobber it.
+            Detach(chunkIndex);
+            chunkIndex = End_ / ChunkSize;
+        }
+
+        auto& chunk = Spine_->Chunks[chunkIndex];
+        chunk->Items[slot] = value;
+        chunk->Summary.Add(value);
+        chunk->Used = slot + 1;
+        End_++;
+    }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args) {
+        push_back(T(std::forward<Args>(args)...));
+    }
+
+    void pop_front() {
+        Begin_++;
+        if (Begin_ == End_) {
+            clear();
+        }
+    }
+
+    // Drops the items from count on. Other versions keep them, the next
+    // append copies the last chunk.
+    void truncate(size_t count) {
+        End_ = Begin_ + std::min(count, size());
+        if (Begin_ == End_) {
+            clear();
+        }
+    }
+
+    // Edits in the middle cost O(end() - position): the tail is re-appended.
+    void insert(const_iterator position, const T& value) {
+        std::vector<T> tail(position, end());
+        truncate(position.Index());
+        push_back(value);
+        for (const auto& item : tail) {
+            push_back(item);
+        }
+    }
+
+    void replace(const_iterator position, const T& value) {
+        std::vector<T> tail(position + 1, end());
+        truncate(position.Index());
+        push_back(value);
+        for (const auto& item : tail) {
+            push_back(item);
+        }
+    }
+
+    // Prepares room for count items: the spine gets enough slots to hold them
+    // twice over and the missing chunks are allocated up front.
+    void reserve(size_t count) {
+        size_t chunks = count / ChunkSize + 2;
+        size_t firstChunk = Begin_ / ChunkSize;
+        size_t liveChunks = (End_ + ChunkSize - 1) / ChunkSize - firstChunk;
+        if (!Spine_ || Spine_->Capacity < firstChunk + 2 * chunks) {
+            Rebuild(firstChunk, liveChunks, std::max(2 * chunks, liveChunks + 1));
+        }
+
+        while (liveChunks + Spine_->Retired.size() < chunks) {
+            Spine_->Retired.push_back(New<TChunk>());
+        }
+    }
+
+    void clear() {
+        Spine_.reset();
+        Begin_ = End_ = 0;
+    }
+
+private:
+    // Makes spine slot chunkIndex writable by this version.
+    void EnsureSpineSlot(size_t chunkIndex) {
+        if (Spine_ && Spine_->Used == chunkIndex && chunkIndex < Spine_->Capacity) {
+            return;
+        }
+
+        size_t firstChunk = Begin_ / ChunkSize;
+        size_t liveChunks = Spine_ ? chunkIndex - firstChunk : 0;
+        Rebuild(firstChunk, liveChunks, std::max<size_t>(16, 2 * (liveChunks + 1)));
+    }
+
+    // Gives this version a private copy of the last chunk and of the spine.
+    void Detach(size_t chunkIndex) {
+        size_t firstChunk = Begin_ / ChunkSize;
+        size_t liveChunks = chunkIndex + 1 - firstChunk;
+        Rebuild(firstChunk, liveChunks, std::max<size_t>(16, 2 * liveChunks));
+
+        size_t lastChunk = liveChunks - 1;
+        auto copy = AllocateChunk();
+        auto& source = Spine_->Chunks[lastChunk];
+        std::copy(source->Items.begin(), source->Items.begin() + End_ % ChunkSize, copy->Items.begin());
+        copy->Used = End_ % ChunkSize;
+        for (size_t slot = 0; slot < copy->Used; slot++) {
+            copy->Summary.Add(copy->Items[slot]);
+        }
+        source = copy;
+    }
+
+    void Rebuild(size_t firstChunk, size_t liveChunks, size_t capacity) {
+        auto spine = New<TSpine>(capacity);
+        for (size_t i = 0; i < liveChunks; i++) {
+            spine->Chunks[i] = Spine_->Chunks[firstChunk + i];
+        }
+        spine->Used = liveChunks;
+
+        if (Spine_) {
+            // Chunks pinned since the previous rebuild are left to the readers
+            // holding them, otherwise a long-lived snapshot would clog the list.
+            auto& retired = spine->Retired;
+            retired = std::move(Spine_->Retired);
+            std::erase_if(retired, [] (const TChunkPtr& chunk) { return !IsUnique(chunk); });
+            for (size_t i = 0; i < firstChunk && retired.size() < capacity; i++) {
+                // Older versions sharing the old spine may still read it.
+                retired.push_back(Spine_->Chunks[i]);
+            }
+        }
+
+        Begin_ -= firstChunk * ChunkSize;
+        End_ -= firstChunk * ChunkSize;
+        Spine_ = std::move(spine);
+    }
+
+    // Takes a retired chunk nobody refers to anymore, a fresh one otherwise.
+    TChunkPtr AllocateChunk() {
+        auto& retired = Spine_->Retired;
+        for (size_t i = 0; i < retired.size(); i++) {
+            if (IsUnique(retired[i])) {
+                auto chunk = std::move(retired[i]);
+                retired[i] = std::move(retired.back());
+                retired.pop_back();
+                chunk->Used = 0;
+                chunk->Summary = TChunkSummary();
+                return chunk;
+            }
+        }
+        return New<TChunk>();
+    }
+
+    static bool IsUnique(const TChunkPtr& chunk) {
+        if (NRefCounted::TRefCountedHelper<TChunk>::GetRefCounter(&*chunk)->GetRefCount() != 1) {
+            return false;
+        }
+        // Pairs with the release of the last reader dropping its reference.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    TSpinePtr Spine_;
+    size_t Begin_ = 0;
+    size_t End_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NCommon
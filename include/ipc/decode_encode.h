@@ -1,3 +1,4 @@
+#include <ipc/frame_reader.h>
 #include <ipc/serial_port.h>
 
 namespace NDecode {
@@ -20,81 +21,96 @@ inline ETemperatureFormat ParseTemperatureFormat(const std::string& format) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+struct TSample {
+    double Temperature = 0;
+};
+
 class TTemperatureDecoderBase {
 public:
-    virtual double ReadTemperature() = 0;
+    explicit TTemperatureDecoderBase(EFraming framing);
+    virtual ~TTemperatureDecoderBase() = default;
+
+    // Decodes every complete frame buffered, the port is read once first if
+    // there are none. Returns the number of samples written, frames that did
+    // not fit into out stay buffered for the next call.
+    size_t ReadTemperatures(std::span<TSample> out);
+
+    // A single sample, NaN if no frame is complete yet.
+    double ReadTemperature();
+
+    // Copies bytes that do not come from the port, e.g. a recorded stream,
+    // into the frame buffer. Returns how many fitted.
+    size_t Append(std::span<const uint8_t> data);
+
+    // Decodes buffered frames until out is full or they run out, the port is
+    // not read. One call covers the whole batch.
+    virtual size_t DecodeBuffered(std::span<TSample> out) = 0;
 
     void SetComPort(NIpc::TComPortPtr comPort);
 
-protected: NIpc::TComPortPtr ComPort_; };
+protected:
+    NIpc::TComPortPtr ComPort_;
+    TFrameReader Frames_;
+};
 
 std::unique_ptr<TTemperatureDecoderBase> CreateDecoder(ETemperatureFormat format);
 
 ////////////////////////////////////////////////////////////////////////////////
 
-class TTextTemperatureDecoder
+class TTextTemperatureDecoder final
     : public TTemperatureDecoderBase
 {
 public:
     TTextTemperatureDecoder();
-    double ReadTemperature() override;
+    size_t DecodeBuffered(std::span<TSample> out) override;
 
 private:
-    std::optional<double> DecodeTextTemperature();
-    size_t ProcessBuffer();
-    
-    std::vector<uint8_t> Buffer_;
-    static constexpr size_t MaxBufferSize = 1024;
+    // The frame is STX "T=" value "C" ETX.
+    std::optional<double> DecodeTextTemperature(std::span<const uint8_t> frame);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
-class TBinaryTemperatureDecoderBase
-    : public TTemperatureDecoderBase
-{
-public:
-    TBinaryTemperatureDecoderBase();
-    double ReadTemperature() override;
-
-protected:
-    virtual std::optional<double> DecodeBinaryTemperature(uint8_t* buffer, size_t size) = 0;
-    
-    std::vector<uint8_t> Buffer_;
-    static constexpr size_t MaxBufferSize = 1024;
-    
-    size_t ProcessBuffer();
+// Layout of a binary payload, the value is the payload number over Divisor.
+struct TBinaryPayload {
+    size_t Width;
+    bool BigEndian;
+    bool Signed;
+    // IEEE754 number of Width bytes instead of an integer.
+    bool FloatingPoint;
+    double Divisor;
 };
 
-////////////////////////////////////////////////////////////////////////////////
-
-class TBinaryByteIntegerTemperatureDecoder
-    : public TBinaryTemperatureDecoderBase
-{
-protected:
-    std::optional<double> DecodeBinaryTemperature(uint8_t* buffer, size_t size) override;
-
-};
+inline constexpr TBinaryPayload ByteIntegerPayload{.Width = 1, .BigEndian = true, .Signed = true, .FloatingPoint = false, .Divisor = 1};
+inline constexpr TBinaryPayload FixedPointPayload{.Width = 2, .BigEndian = true, .Signed = true, .FloatingPoint = false, .Divisor = 10};
+inline constexpr TBinaryPayload FloatingPointPayload{.Width = 4, .BigEndian = true, .Signed = false, .FloatingPoint = true, .Divisor = 1};
 
-class TBinaryFixedPointTemperatureDecoder
-    : public TBinaryTemperatureDecoderBase
+// The frame is STX, command, length, payload, checksum, ETX. The payload
+// layout is a template argument, so the checksum and the conversion are
+// unrolled for each format and no frame goes through a virtual call.
+// Instantiated for the layouts above in decode_encode.cpp.
+template <TBinaryPayload Payload>
+class TBinaryTemperatureDecoder final
+    : public TTemperatureDecoderBase
 {
-protected:
-    std::optional<double> DecodeBinaryTemperature(uint8_t* buffer, size_t size) override;
+public:
+    TBinaryTemperatureDecoder();
+    size_t DecodeBuffered(std::span<TSample> out) override;
 
+private:
+    static std::optional<double> DecodeBinaryTemperature(std::span<const uint8_t> frame);
 };
 
-class TBinaryFloatingPointTemperatureDecoder
-    : public TBinaryTemperatureDecoderBase
-{
-protected:
-    std::optional<double> DecodeBinaryTemperature(uint8_t* buffer, size_t size) override;
-
-};
+using TBinaryByteIntegerTemperatureDecoder = TBinaryTemperatureDecoder<ByteIntegerPayload>;
+using TBinaryFixedPointTemperatureDecoder = TBinaryTemperatureDecoder<FixedPointPayload>;
+using TBinaryFloatingPointTemperatureDecoder = TBinaryTemperatureDecoder<FloatingPointPayload>;
 
 ////////////////////////////////////////////////////////////////////////////////
 
 class TTemperatureEncoderBase {
 public:
+    virtual ~TTemperatureEncoderBase() = default;
+
     virtual void WriteTemperature(double value) = 0;
 
     void SetComPort(NIpc::TComPortPtr comPort);
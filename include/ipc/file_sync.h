@@ -0,0 +1,15 @@
+#pragma once
+
+#include <filesystem>
+
+namespace NIpc {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Forces written data of the file to stable storage.
+// Returns false and logs a warning when the file cannot be synced.
+bool SyncFile(const std::filesystem::path& path);
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NIpc
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <ipc/serial_port.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace NDecode {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Fixed-size byte ring. Bytes are read straight into the free space and
+// consumed from the front, nothing is shifted or reallocated afterwards.
+class TByteRing {
+public:
+    // The capacity is rounded up to a power of two.
+    explicit TByteRing(size_t capacity);
+
+    size_t GetSize() const { return Tail_ - Head_; }
+    size_t GetCapacity() const { return Storage_.size(); }
+
+    uint8_t operator[](size_t index) const { return Storage_[(Head_ + index) & Mask_]; }
+
+    // Largest contiguous free block, Commit the bytes written into it.
+    std::span<uint8_t> GetWritable();
+    void Commit(size_t size);
+
+    void Consume(size_t size);
+
+    // Position of the first byte at or after from equal to first or second,
+    // GetSize() if there is none.
+    size_t Find(uint8_t first, uint8_t second, size_t from) const {
+        // Frames are short, so the byte searched for is usually a few bytes
+        // away. Those are checked here, the wide scan takes longer runs.
+        size_t size = GetSize();
+        size_t limit = std::min(size, from + 16);
+        for (; from < limit; from++) {
+            uint8_t byte = (*this)[from];
+            if (byte == first || byte == second) {
+                return from;
+            }
+        }
+        return from < size ? FindWide(first, second, from) : size;
+    }
+
+    // Bytes [offset, offset + size) in one piece. They are copied to scratch
+    // only when they wrap around the end of the storage.
+    std::span<const uint8_t> GetSpan(size_t offset, size_t size, std::vector<uint8_t>& scratch) const;
+
+private:
+    // SSE2 or AVX2 scan, whichever the CPU has.
+    size_t FindWide(uint8_t first, uint8_t second, size_t from) const;
+
+    std::vector<uint8_t> Storage_;
+    size_t Mask_;
+
+    // Positions grow monotonically and are masked on access.
+    size_t Head_ = 0;
+    size_t Tail_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+enum class EFraming {
+    Delimited,      // STX ... ETX, a new STX restarts the frame
+    LengthPrefixed  // STX, command, length, payload, checksum, ETX
+};
+
+// Splits the serial stream into frames. Every byte is looked at a constant
+// number of times: the search for a frame end resumes where the previous
+// one stopped, and junk between frames is dropped as it is passed.
+class TFrameReader {
+public:
+    static constexpr uint8_t STX = 0x02;
+    static constexpr uint8_t ETX = 0x03;
+    static constexpr uint8_t Command = 0x54;
+
+    explicit TFrameReader(EFraming framing, size_t capacity = 1024);
+
+    // Reads what the port has into the free space, returns the bytes read.
+    size_t Fill(NIpc::TComPort& port);
+
+    // Copies bytes of a stream that does not come from a port, returns how
+    // many fitted.
+    size_t Append(std::span<const uint8_t> data);
+
+    // Next complete frame with its STX and ETX, empty if more bytes are
+    // needed. The frame stays valid until the next call.
+    std::span<const uint8_t> Next();
+
+private:
+    TByteRing Ring_;
+    EFraming Framing_;
+
+    // Bytes after the frame start known to hold no frame end.
+    size_t Scanned_ = 0;
+
+    // Size of the frame handed out last, consumed on the next call.
+    size_t Pending_ = 0;
+
+    std::vector<uint8_t> Scratch_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NDecode
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <common/intrusive_ptr.h>
+#include <common/refcounted.h>
+
+#include <cstddef>
+#include <filesystem>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+namespace NIpc {
+
+////////////////////////////////////////////////////////////////////////////////
+
+enum class EMappingMode {
+    ReadWrite,  // Created if missing and extended to minSize
+    ReadOnly    // Must exist, mapped as is; an empty file has no data
+};
+
+// Shared mapping of a whole file.
+// The file is extended to at least minSize bytes before mapping; the mapping
+// keeps its size, map the file again to see it grow.
+class TMappedFile
+    : public NRefCounted::TRefCountedBase
+{
+public:
+    TMappedFile(const std::filesystem::path& path, size_t minSize, EMappingMode mode = EMappingMode::ReadWrite);
+    ~TMappedFile();
+
+    void* GetData();
+    const void* GetData() const;
+
+    size_t GetSize() const;
+
+    const std::filesystem::path& GetPath() const;
+
+    // Flushes dirty pages to disk, waits for completion when sync is set.
+    void Flush(bool sync);
+
+private:
+    void Close();
+
+    std::filesystem::path Path_;
+    EMappingMode Mode_;
+    size_t Size_ = 0;
+    void* Data_ = nullptr;
+
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE File_ = INVALID_HANDLE_VALUE;
+    HANDLE Mapping_ = NULL;
+#else
+    int Desc_ = -1;
+#endif
+};
+
+DECLARE_REFCOUNTED(TMappedFile);
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NIpc
@@ -0,0 +1 @@
+#include <common/persistent_sequence.h>
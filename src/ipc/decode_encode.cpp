@@ -4,6 +4,10 @@
 #include <cstring>
 #include <cmath>
 #include <algorithm>
+#include <bit>
+#include <charconv>
+#include <string_view>
+#include <system_error>
 
 
 namespace NDecode {
@@ -19,6 +23,109 @@ constexpr uint8_t ETX = 0x03;  // End of Text
 constexpr uint8_t CR = 0x0D;   // Carriage Return
 constexpr uint8_t LF = 0x0A;   // Line Feed
 
+// Payload of a frame with the expected length and a matching checksum.
+template <size_t Width>
+std::optional<std::span<const uint8_t, Width>> GetPayload(std::span<const uint8_t> frame) {
+    if (frame[2] != Width) {
+        return std::nullopt;
+    }
+
+    uint8_t calculatedChecksum = frame[1] ^ frame[2];
+    for (size_t i = 0; i < Width; i++) {
+        calculatedChecksum ^= frame[3 + i];
+    }
+
+    uint8_t packetChecksum = frame[3 + Width];
+    if (calculatedChecksum != packetChecksum) {
+        LOG_WARNING("Checksum mismatch: calculated={:#x}, received={:#x}",
+                  calculatedChecksum, packetChecksum);
+        return std::nullopt;
+    }
+
+    return frame.subspan<3, Width>();
+}
+
+template <TBinaryPayload Payload>
+double ConvertPayload(std::span<const uint8_t, Payload.Width> data) {
+    static_assert(Payload.Width >= 1 && Payload.Width <= 8, "Payload must fit into 64 bits");
+
+    uint64_t bits = 0;
+    for (size_t i = 0; i < Payload.Width; i++) {
+        size_t shift = Payload.BigEndian ? 8 * (Payload.Width - 1 - i) : 8 * i;
+        bits |= static_cast<uint64_t>(data[i]) << shift;
+    }
+
+    if constexpr (Payload.FloatingPoint) {
+        static_assert(Payload.Width == 4 || Payload.Width == 8, "Floating point payload must be 4 or 8 bytes");
+        if constexpr (Payload.Width == 4) {
+            return std::bit_cast<float>(static_cast<uint32_t>(bits)) / Payload.Divisor;
+        } else {
+            return std::bit_cast<double>(bits) / Payload.Divisor;
+        }
+    } else if constexpr (Payload.Signed) {
+        // Shifting the sign bit to the top and back extends it.
+        constexpr size_t unused = 64 - 8 * Payload.Width;
+        return static_cast<double>(static_cast<int64_t>(bits << unused) >> unused) / Payload.Divisor;
+    } else {
+        return static_cast<double>(bits) / Payload.Divisor;
+    }
+}
+
+// Parses [+-]digits[.digits] in place, as the encoder writes it. Up to 15
+// digits and a power of ten up to 1e15 are exact doubles, so the quotient is
+// rounded once and matches strtod. Other shapes are left to from_chars, which
+// unlike strtod does not depend on the locale.
+std::errc ParseTemperature(std::string_view text, double& value) {
+    static constexpr double PowersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+
+    bool negative = false;
+    if (!text.empty() && (text.front() == '+' || text.front() == '-')) {
+        negative = text.front() == '-';
+        text.remove_prefix(1);
+    }
+    if (text.empty() || text.front() == '+' || text.front() == '-') {
+        return std::errc::invalid_argument;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = -1;
+    size_t position = 0;
+    for (; position < text.size() && digits <= 15; position++) {
+        char symbol = text[position];
+        if (symbol >= '0' && symbol <= '9') {
+            mantissa = mantissa * 10 + (symbol - '0');
+            digits++;
+            if (fractionDigits >= 0) {
+                fractionDigits++;
+            }
+        } else if (symbol == '.' && fractionDigits < 0) {
+            fractionDigits = 0;
+        } else {
+            break;
+        }
+    }
+
+    if (position == text.size() && digits > 0 && digits <= 15) {
+        value = static_cast<double>(mantissa) / PowersOfTen[std::max(fractionDigits, 0)];
+    } else {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc()) {
+            return error;
+        }
+        if (end != text.data() + text.size()) {
+            return std::errc::invalid_argument;
+        }
+    }
+
+    if (negative) {
+        value = -value;
+    }
+    return std::errc();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 } // namespace
@@ -55,6 +162,10 @@ std::unique_ptr<TTemperatureEncoderBase> CreateEncoder(NDecode::ETemperatureForm
 
 ////////////////////////////////////////////////////////////////////////////////
 
+TTemperatureDecoderBase::TTemperatureDecoderBase(EFraming framing)
+    : Frames_(framing)
+{ }
+
 void TTemperatureDecoderBase::SetComPort(NIpc::TComPortPtr comPort) {
     ComPort_ = comPort;
     
@@ -73,333 +184,118 @@ void TTemperatureDecoderBase::SetComPort(NIpc::TComPortPtr comPort) {
     }
 }
 
-////////////////////////////////////////////////////////////////////////////////
-
-TTextTemperatureDecoder::TTextTemperatureDecoder()
-    : Buffer_(256, 0)
-{
-}
-
-double TTextTemperatureDecoder::ReadTemperature() {
+size_t TTemperatureDecoderBase::ReadTemperatures(std::span<TSample> out) {
     if (!ComPort_ || !ComPort_->IsOpen()) {
         THROW("Port not open or not initialized");
     }
-    
-    if (Buffer_.size() >= MaxBufferSize) {
-        LOG_WARNING("Buffer exceeded maximum size ({}), resetting", MaxBufferSize);
-        Buffer_.clear();
-        Buffer_.resize(256, 0);
-    }
-    
-    uint8_t tempBuffer[256] = {0};
-    size_t bytesRead = ComPort_->Read(tempBuffer, sizeof(tempBuffer));
-    
-    if (bytesRead > 0) {
-        LOG_DEBUG("Read {} bytes from serial port", bytesRead);
-        
-        size_t oldSize = Buffer_.size();
-        Buffer_.resize(oldSize + bytesRead);
-        std::memcpy(Buffer_.data() + oldSize, tempBuffer, bytesRead);
+
+    // Frames left from the previous read go first, the port read blocks
+    // until data comes, so it is not done while there are any.
+    size_t count = DecodeBuffered(out);
+    if (count == 0 && !out.empty()) {
+        size_t bytesRead = Frames_.Fill(*ComPort_);
+        if (bytesRead > 0) {
+            LOG_DEBUG("Read {} bytes from serial port", bytesRead);
+            count = DecodeBuffered(out);
+        }
     }
-    
-    auto result = DecodeTextTemperature();
-    
-    ProcessBuffer();
-    
-    if (result) {
-        LOG_DEBUG("Decoded temperature: {}", *result);
-        return *result;
+
+    if (count > 0) {
+        LOG_DEBUG("Decoded {} temperatures, last: {}", count, out[count - 1].Temperature);
     }
-    
-    return NAN;
+    return count;
 }
 
-std::optional<double> TTextTemperatureDecoder::DecodeTextTemperature() {
-    for (size_t pos = 0; pos < Buffer_.size() - 10; pos++) {
-        if (Buffer_[pos] != STX) {
-            continue;
-        }
-        
-        if (pos + 2 >= Buffer_.size() || Buffer_[pos + 1] != 'T' || Buffer_[pos + 2] != '=') {
-            continue;
-        }
-        
-        size_t etxPos = pos + 3;
-        while (etxPos < Buffer_.size() && Buffer_[etxPos] != ETX) {
-            etxPos++;
-        }
-        
-        if (etxPos >= Buffer_.size()) {
-            break;
-        }
-        
-        std::string tempStr;
-        for (size_t i = pos + 3; i < etxPos; i++) {
-            tempStr.push_back(static_cast<char>(Buffer_[i]));
-        }
-        
-        if (tempStr.empty() || tempStr.back() != 'C') {
-            LOG_WARNING("Invalid temperature format: {}", tempStr);
-            continue;
-        }
-        
-        tempStr.pop_back();
-        
-        try {
-            double temp = std::stod(tempStr);
-            return temp;
-        } catch (const std::exception& ex) {
-            LOG_WARNING("Failed to parse temperature: '{}', error: {}", tempStr, ex.what());
-            continue;
-        }
+double TTemperatureDecoderBase::ReadTemperature() {
+    TSample sample;
+    if (ReadTemperatures({&sample, 1}) == 0) {
+        return NAN;
     }
-    
-    return std::nullopt;
+    return sample.Temperature;
 }
 
-size_t TTextTemperatureDecoder::ProcessBuffer() {
-    for (size_t pos = 0; pos < Buffer_.size() - 5; pos++) {
-        if (Buffer_[pos] != STX) {
-            continue;
-        }
-        
-        size_t etxPos = pos + 1;
-        while (etxPos < Buffer_.size() && Buffer_[etxPos] != ETX) {
-            etxPos++;
-        }
-        
-        if (etxPos >= Buffer_.size()) {
-            break;
-        }
-        
-        if (etxPos + 2 < Buffer_.size() && Buffer_[etxPos + 1] == CR && Buffer_[etxPos + 2] == LF) {
-            size_t msgEnd = etxPos + 3;
-            
-            if (msgEnd < Buffer_.size()) {
-                std::copy(Buffer_.begin() + msgEnd, Buffer_.end(), Buffer_.begin());
-                Buffer_.resize(Buffer_.size() - msgEnd);
-                return msgEnd;
-            } else {
-                Buffer_.clear();
-                Buffer_.resize(256, 0);
-                return msgEnd;
-            }
-        }
-    }
-    
-    return 0;
+size_t TTemperatureDecoderBase::Append(std::span<const uint8_t> data) {
+    return Frames_.Append(data);
 }
+
 ////////////////////////////////////////////////////////////////////////////////
 
-TBinaryTemperatureDecoderBase::TBinaryTemperatureDecoderBase()
-    : Buffer_(256, 0)
+TTextTemperatureDecoder::TTextTemperatureDecoder()
+    : TTemperatureDecoderBase(EFraming::Delimited)
 { }
 
-double TBinaryTemperatureDecoderBase::ReadTemperature() {
-    if (!ComPort_ || !ComPort_->IsOpen()) {
-        THROW("Port not open or not initialized");
-    }
-    
-    if (Buffer_.size() >= MaxBufferSize) {
-        LOG_WARNING("Buffer exceeded maximum size ({}), resetting", MaxBufferSize);
-        Buffer_.clear();
-        Buffer_.resize(256, 0);
-    }
-    
-    uint8_t tempBuffer[256] = {0};
-    size_t bytesRead = ComPort_->Read(tempBuffer, sizeof(tempBuffer));
-    
-    if (bytesRead > 0) {
-        LOG_DEBUG("Read {} bytes from serial port", bytesRead);
-        
-        size_t oldSize = Buffer_.size();
-        Buffer_.resize(oldSize + bytesRead);
-        std::memcpy(Buffer_.data() + oldSize, tempBuffer, bytesRead);
-    }
-    
-    auto result = DecodeBinaryTemperature(Buffer_.data(), Buffer_.size());
-    
-    ProcessBuffer();
-    
-    if (result) {
-        LOG_DEBUG("Decoded temperature: {}", *result);
-        return *result;
-    }
-    
-    return NAN;
-}
-
-size_t TBinaryTemperatureDecoderBase::ProcessBuffer() {
-    for (size_t pos = 0; pos < Buffer_.size() - 5; pos++) {
-        if (Buffer_[pos] != 0x02) {
-            continue;
-        }
-        
-        if (Buffer_[pos + 1] != 0x54) {
-            continue;
-        }
-        
-        uint8_t dataLen = Buffer_[pos + 2];
-        
-        if (pos + 3 + dataLen + 2 > Buffer_.size()) {
+size_t TTextTemperatureDecoder::DecodeBuffered(std::span<TSample> out) {
+    size_t count = 0;
+    while (count < out.size()) {
+        auto frame = Frames_.Next();
+        if (frame.empty()) {
             break;
         }
-        
-        if (Buffer_[pos + 3 + dataLen + 1] == 0x03) {
-            size_t packetEnd = pos + 3 + dataLen + 2;
-            
-            if (packetEnd < Buffer_.size()) {
-                std::copy(Buffer_.begin() + packetEnd, Buffer_.end(), Buffer_.begin());
-                Buffer_.resize(Buffer_.size() - packetEnd);
-                return packetEnd;
-            } else {
-                Buffer_.clear();
-                Buffer_.resize(256, 0);
-                return packetEnd;
-            }
+        if (auto temperature = DecodeTextTemperature(frame)) {
+            out[count++].Temperature = *temperature;
         }
     }
-    
-    return 0;
+    return count;
 }
 
-////////////////////////////////////////////////////////////////////////////////
+std::optional<double> TTextTemperatureDecoder::DecodeTextTemperature(std::span<const uint8_t> frame) {
+    if (frame.size() < 4 || frame[1] != 'T' || frame[2] != '=') {
+        return std::nullopt;
+    }
 
-std::optional<double> TBinaryByteIntegerTemperatureDecoder::DecodeBinaryTemperature(uint8_t* buffer, size_t size) {
-    for (size_t pos = 0; pos < size - 5; pos++) {
-        if (buffer[pos] != 0x02) {
-            continue;
-        }
-        
-        uint8_t cmd = buffer[pos + 1];
-        if (cmd != 0x54) {
-            continue;
-        }
-        
-        uint8_t dataLen = buffer[pos + 2];
-        if (dataLen != 1) {
-            continue;
-        }
-        
-        if (pos + 3 + dataLen + 2 > size) {
-            break;
-        }
-        
-        if (buffer[pos + 3 + dataLen + 1] != 0x03) {
-            continue;
-        }
-        
-        uint8_t calculatedChecksum = cmd ^ dataLen ^ buffer[pos + 3];
-        
-        uint8_t packetChecksum = buffer[pos + 3 + dataLen];
-        if (calculatedChecksum != packetChecksum) {
-            LOG_WARNING("Checksum mismatch: calculated={:#x}, received={:#x}", 
-                      calculatedChecksum, packetChecksum);
-            continue;
-        }
-        
-        const uint8_t* data = buffer + pos + 3;
-        return static_cast<double>(static_cast<int8_t>(data[0]));
+    // The value is parsed where it lies in the frame buffer.
+    std::string_view text(reinterpret_cast<const char*>(frame.data()) + 3, frame.size() - 4);
+
+    if (text.empty() || text.back() != 'C') {
+        LOG_WARNING("Invalid temperature format: {}", text);
+        return std::nullopt;
     }
-    
-    return std::nullopt;
-}
 
-////////////////////////////////////////////////////////////////////////////////
+    text.remove_suffix(1);
 
-std::optional<double> TBinaryFixedPointTemperatureDecoder::DecodeBinaryTemperature(uint8_t* buffer, size_t size) {
-    for (size_t pos = 0; pos < size - 6; pos++) {
-        if (buffer[pos] != 0x02) {
-            continue;
-        }
-        
-        uint8_t cmd = buffer[pos + 1];
-        if (cmd != 0x54) {
-            continue;
-        }
-        
-        uint8_t dataLen = buffer[pos + 2];
-        if (dataLen != 2) {
-            continue;
-        }
-        
-        if (pos + 3 + dataLen + 2 > size) {
-            break;
-        }
-        
-        if (buffer[pos + 3 + dataLen + 1] != 0x03) {
-            continue;
-        }
-        
-        uint8_t calculatedChecksum = cmd ^ dataLen;
-        for (size_t i = 0; i < dataLen; i++) {
-            calculatedChecksum ^= buffer[pos + 3 + i];
-        }
-        
-        uint8_t packetChecksum = buffer[pos + 3 + dataLen];
-        if (calculatedChecksum != packetChecksum) {
-            LOG_WARNING("Checksum mismatch: calculated={:#x}, received={:#x}", 
-                      calculatedChecksum, packetChecksum);
-            continue;
-        }
-        
-        const uint8_t* data = buffer + pos + 3;
-        uint16_t tempInt = (data[0] << 8) | data[1];
-        return tempInt / 10.0;
+    double temperature;
+    if (auto error = ParseTemperature(text, temperature); error != std::errc()) {
+        LOG_WARNING("Failed to parse temperature: '{}', error: {}", text, std::make_error_code(error).message());
+        return std::nullopt;
     }
-    
-    return std::nullopt;
+    return temperature;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-std::optional<double> TBinaryFloatingPointTemperatureDecoder::DecodeBinaryTemperature(uint8_t* buffer, size_t size) {
-    for (size_t pos = 0; pos < size - 8; pos++) {
-        if (buffer[pos] != 0x02) {
-            continue;
-        }
-        
-        uint8_t cmd = buffer[pos + 1];
-        if (cmd != 0x54) {
-            continue;
-        }
-        
-        uint8_t dataLen = buffer[pos + 2];
-        if (dataLen != 4) {
-            continue;
-        }
-        
-        if (pos + 3 + dataLen + 2 > size) {
+template <TBinaryPayload Payload>
+TBinaryTemperatureDecoder<Payload>::TBinaryTemperatureDecoder()
+    : TTemperatureDecoderBase(EFraming::LengthPrefixed)
+{ }
+
+template <TBinaryPayload Payload>
+size_t TBinaryTemperatureDecoder<Payload>::DecodeBuffered(std::span<TSample> out) {
+    size_t count = 0;
+    while (count < out.size()) {
+        auto frame = Frames_.Next();
+        if (frame.empty()) {
             break;
         }
-        
-        if (buffer[pos + 3 + dataLen + 1] != 0x03) {
-            continue;
+        if (auto temperature = DecodeBinaryTemperature(frame)) {
+            out[count++].Temperature = *temperature;
         }
-        
-        uint8_t calculatedChecksum = cmd ^ dataLen;
-        for (size_t i = 0; i < dataLen; i++) {
-            calculatedChecksum ^= buffer[pos + 3 + i];
-        }
-        
-        uint8_t packetChecksum = buffer[pos + 3 + dataLen];
-        if (calculatedChecksum != packetChecksum) {
-            LOG_WARNING("Checksum mismatch: calculated={:#x}, received={:#x}", 
-                      calculatedChecksum, packetChecksum);
-            continue;
-        }
-        
-        const uint8_t* data = buffer + pos + 3;
-        float tempValue;
-        uint32_t tempBits = (data[0] << 24) | (data[1] << 16) | 
-                           (data[2] << 8) | data[3];
-        std::memcpy(&tempValue, &tempBits, sizeof(float));
-        return static_cast<double>(tempValue);
     }
-    
-    return std::nullopt;
+    return count;
 }
 
+template <TBinaryPayload Payload>
+std::optional<double> TBinaryTemperatureDecoder<Payload>::DecodeBinaryTemperature(std::span<const uint8_t> frame) {
+    auto data = GetPayload<Payload.Width>(frame);
+    if (!data) {
+        return std::nullopt;
+    }
+    return ConvertPayload<Payload>(*data);
+}
+
+template class TBinaryTemperatureDecoder<ByteIntegerPayload>;
+template class TBinaryTemperatureDecoder<FixedPointPayload>;
+template class TBinaryTemperatureDecoder<FloatingPointPayload>;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void TTemperatureEncoderBase::SetComPort(NIpc::TComPortPtr comPort) {
@@ -0,0 +1,58 @@
+#include <ipc/file_sync.h>
+
+#include <common/format.h>
+#include <common/logging.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace NIpc {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "FileSync";
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SyncFile(const std::filesystem::path& path) {
+#if defined(_WIN32) || defined(_WIN64)
+    int desc = _wopen(path.c_str(), _O_RDWR | _O_BINARY);
+    if (desc == -1) {
+        LOG_WARNING("Failed to open {} for sync: {}", path, Errno);
+        return false;
+    }
+    bool synced = _commit(desc) == 0;
+    if (!synced) {
+        LOG_WARNING("Failed to sync {}: {}", path, Errno);
+    }
+    _close(desc);
+#else
+    int desc = ::open(path.c_str(), O_RDONLY);
+    if (desc == -1) {
+        LOG_WARNING("Failed to open {} for sync: {}", path, Errno);
+        return false;
+    }
+    bool synced = ::fsync(desc) == 0;
+    if (!synced) {
+        LOG_WARNING("Failed to sync {}: {}", path, Errno);
+    }
+    ::close(desc);
+#endif
+    return synced;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NIpc
@@ -0,0 +1,241 @@
+#include <ipc/frame_reader.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FRAME_READER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRAME_READER_AVX2
+#include <immintrin.h>
+#endif
+
+namespace NDecode {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "FrameReader";
+
+// STX, command, length, checksum and ETX around the payload.
+constexpr size_t LengthPrefixedOverhead = 5;
+
+// Scanners for the first byte equal to either of two, returning end if
+// there is none. Frame bytes are rare in a stream of payload, so the wide
+// ones mostly just compare and move on.
+using TFindEither = const uint8_t* (*)(const uint8_t* begin, const uint8_t* end, uint8_t first, uint8_t second);
+
+const uint8_t* FindEitherScalar(const uint8_t* begin, const uint8_t* end, uint8_t first, uint8_t second) {
+    for (; begin != end; ++begin) {
+        if (*begin == first || *begin == second) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+#ifdef FRAME_READER_SSE2
+const uint8_t* FindEitherSse2(const uint8_t* begin, const uint8_t* end, uint8_t first, uint8_t second) {
+    __m128i firstMask = _mm_set1_epi8(static_cast<char>(first));
+    __m128i secondMask = _mm_set1_epi8(static_cast<char>(second));
+    for (; end - begin >= 16; begin += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, firstMask), _mm_cmpeq_epi8(chunk, secondMask));
+        if (auto bits = static_cast<uint32_t>(_mm_movemask_epi8(matches))) {
+            return begin + std::countr_zero(bits);
+        }
+    }
+    return FindEitherScalar(begin, end, first, second);
+}
+#endif
+
+#ifdef FRAME_READER_AVX2
+__attribute__((target("avx2")))
+const uint8_t* FindEitherAvx2(const uint8_t* begin, const uint8_t* end, uint8_t first, uint8_t second) {
+    __m256i firstMask = _mm256_set1_epi8(static_cast<char>(first));
+    __m256i secondMask = _mm256_set1_epi8(static_cast<char>(second));
+    for (; end - begin >= 32; begin += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, firstMask), _mm256_cmpeq_epi8(chunk, secondMask));
+        if (auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(matches))) {
+            return begin + std::countr_zero(bits);
+        }
+    }
+    return FindEitherScalar(begin, end, first, second);
+}
+#endif
+
+TFindEither SelectFindEither() {
+#ifdef FRAME_READER_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return FindEitherAvx2;
+    }
+#endif
+#ifdef FRAME_READER_SSE2
+    return FindEitherSse2;
+#else
+    return FindEitherScalar;
+#endif
+}
+
+// Picked once by what the CPU supports.
+const TFindEither FindEither = SelectFindEither();
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TByteRing::TByteRing(size_t capacity)
+    : Storage_(std::bit_ceil(std::max<size_t>(capacity, 1))),
+      Mask_(Storage_.size() - 1)
+{ }
+
+std::span<uint8_t> TByteRing::GetWritable() {
+    size_t offset = Tail_ & Mask_;
+    size_t size = std::min(GetCapacity() - GetSize(), GetCapacity() - offset);
+    return {Storage_.data() + offset, size};
+}
+
+void TByteRing::Commit(size_t size) {
+    ASSERT(GetSize() + size <= GetCapacity(), "Byte ring overflow");
+    Tail_ += size;
+}
+
+void TByteRing::Consume(size_t size) {
+    ASSERT(size <= GetSize(), "Byte ring underflow");
+    Head_ += size;
+}
+
+size_t TByteRing::FindWide(uint8_t first, uint8_t second, size_t from) const {
+    // At most two contiguous pieces: up to the end of the storage and after.
+    size_t size = GetSize();
+    while (from < size) {
+        size_t offset = (Head_ + from) & Mask_;
+        size_t length = std::min(size - from, GetCapacity() - offset);
+        const uint8_t* begin = Storage_.data() + offset;
+        const uint8_t* found = FindEither(begin, begin + length, first, second);
+        if (found != begin + length) {
+            return from + (found - begin);
+        }
+        from += length;
+    }
+    return size;
+}
+
+std::span<const uint8_t> TByteRing::GetSpan(size_t offset, size_t size, std::vector<uint8_t>& scratch) const {
+    size_t begin = (Head_ + offset) & Mask_;
+    if (begin + size <= GetCapacity()) {
+        return {Storage_.data() + begin, size};
+    }
+
+    size_t head = GetCapacity() - begin;
+    std::memcpy(scratch.data(), Storage_.data() + begin, head);
+    std::memcpy(scratch.data() + head, Storage_.data(), size - head);
+    return {scratch.data(), size};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TFrameReader::TFrameReader(EFraming framing, size_t capacity)
+    : Ring_(std::max(capacity, 256 + LengthPrefixedOverhead)),
+      Framing_(framing),
+      Scratch_(Ring_.GetCapacity())
+{ }
+
+size_t TFrameReader::Fill(NIpc::TComPort& port) {
+    auto writable = Ring_.GetWritable();
+    if (writable.empty()) {
+        return 0;
+    }
+    size_t bytesRead = port.Read(writable.data(), writable.size());
+    Ring_.Commit(bytesRead);
+    return bytesRead;
+}
+
+size_t TFrameReader::Append(std::span<const uint8_t> data) {
+    size_t appended = 0;
+    while (appended < data.size()) {
+        auto writable = Ring_.GetWritable();
+        if (writable.empty()) {
+            break;
+        }
+        size_t size = std::min(writable.size(), data.size() - appended);
+        std::memcpy(writable.data(), data.data() + appended, size);
+        Ring_.Commit(size);
+        appended += size;
+    }
+    return appended;
+}
+
+std::span<const uint8_t> TFrameReader::Next() {
+    Ring_.Consume(Pending_);
+    Pending_ = 0;
+
+    while (Ring_.GetSize()) {
+        if (Ring_[0] != STX) {
+            Ring_.Consume(Ring_.Find(STX, STX, 0));
+            Scanned_ = 0;
+            continue;
+        }
+
+        size_t frameSize = 0;
+        if (Framing_ == EFraming::Delimited) {
+            size_t end = Ring_.Find(STX, ETX, std::max<size_t>(Scanned_, 1));
+            if (end < Ring_.GetSize() && Ring_[end] == STX) {
+                // The frame was cut off, the new one replaces it.
+                Ring_.Consume(end);
+                Scanned_ = 0;
+                continue;
+            }
+            Scanned_ = end;
+            if (end < Ring_.GetSize()) {
+                frameSize = end + 1;
+            }
+        } else if (Ring_.GetSize() >= 3) {
+            if (Ring_[1] != Command) {
+                // A payload byte that looked like STX.
+                Ring_.Consume(1);
+                continue;
+            }
+            size_t size = Ring_[2] + LengthPrefixedOverhead;
+            if (Ring_.GetSize() >= size) {
+                if (Ring_[size - 1] != ETX) {
+                    Ring_.Consume(1);
+                    continue;
+                }
+                frameSize = size;
+            }
+        }
+
+        if (frameSize == 0) {
+            if (Ring_.GetSize() < Ring_.GetCapacity()) {
+                return {};
+            }
+            LOG_WARNING("Frame does not fit into the buffer ({} bytes), dropping it", Ring_.GetCapacity());
+            Ring_.Consume(1);
+            Scanned_ = 0;
+            continue;
+        }
+
+        Pending_ = frameSize;
+        Scanned_ = 0;
+        return Ring_.GetSpan(0, frameSize, Scratch_);
+    }
+
+    Scanned_ = 0;
+    return {};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NDecode
@@ -0,0 +1,182 @@
+#include <ipc/mapped_file.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NIpc {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "MappedFile";
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TMappedFile::TMappedFile(const std::filesystem::path& path, size_t minSize, EMappingMode mode)
+    : Path_(path),
+      Mode_(mode)
+{
+    bool readOnly = Mode_ == EMappingMode::ReadOnly;
+
+#if defined(_WIN32) || defined(_WIN64)
+    File_ = CreateFileW(
+        Path_.c_str(),
+        readOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        readOnly ? OPEN_EXISTING : OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    ASSERT(File_ != INVALID_HANDLE_VALUE, "Failed to open file {}: {}", Path_, GetLastError());
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(File_, &fileSize);
+    Size_ = static_cast<size_t>(fileSize.QuadPart);
+    if (!readOnly) {
+        Size_ = std::max(Size_, minSize);
+    }
+
+    if (Size_ == 0) {
+        LOG_DEBUG("File {} is empty, nothing to map", Path_);
+        return;
+    }
+
+    Mapping_ = CreateFileMappingA(
+        File_,
+        NULL,
+        readOnly ? PAGE_READONLY : PAGE_READWRITE,
+        static_cast<DWORD>((static_cast<uint64_t>(Size_) >> 32) & 0xFFFFFFFF),
+        static_cast<DWORD>(Size_ & 0xFFFFFFFF),
+        NULL);
+    if (Mapping_ == NULL) {
+        auto error = GetLastError();
+        Close();
+        THROW("Failed to create mapping of {}: {}", Path_, error);
+    }
+
+    Data_ = MapViewOfFile(Mapping_, readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, Size_);
+    if (Data_ == NULL) {
+        auto error = GetLastError();
+        Close();
+        THROW("Failed to map {}: {}", Path_, error);
+    }
+#else
+    Desc_ = readOnly
+        ? ::open(Path_.c_str(), O_RDONLY)
+        : ::open(Path_.c_str(), O_RDWR | O_CREAT, 0644);
+    ASSERT(Desc_ != -1, "Failed to open file {}: {}", Path_, Errno);
+
+    struct stat st;
+    if (fstat(Desc_, &st) == -1) {
+        auto error = Errno;
+        Close();
+        THROW("Failed to stat {}: {}", Path_, error);
+    }
+
+    Size_ = static_cast<size_t>(st.st_size);
+    if (!readOnly && Size_ < minSize) {
+        if (ftruncate(Desc_, minSize) == -1) {
+            auto error = Errno;
+            Close();
+            THROW("Failed to extend {} to {} bytes: {}", Path_, minSize, error);
+        }
+        Size_ = minSize;
+    }
+
+    if (Size_ == 0) {
+        LOG_DEBUG("File {} is empty, nothing to map", Path_);
+        return;
+    }
+
+    Data_ = readOnly
+        ? mmap(nullptr, Size_, PROT_READ, MAP_PRIVATE, Desc_, 0)
+        : mmap(nullptr, Size_, PROT_READ | PROT_WRITE, MAP_SHARED, Desc_, 0);
+    if (Data_ == MAP_FAILED) {
+        Data_ = nullptr;
+        auto error = Errno;
+        Close();
+        THROW("Failed to map {}: {}", Path_, error);
+    }
+#endif
+
+    LOG_DEBUG("File {} mapped, size: {} bytes", Path_, Size_);
+}
+
+TMappedFile::~TMappedFile() {
+    Close();
+}
+
+void* TMappedFile::GetData() {
+    return Data_;
+}
+
+const void* TMappedFile::GetData() const {
+    return Data_;
+}
+
+size_t TMappedFile::GetSize() const {
+    return Size_;
+}
+
+const std::filesystem::path& TMappedFile::GetPath() const {
+    return Path_;
+}
+
+void TMappedFile::Flush(bool sync) {
+    if (!Data_ || Mode_ == EMappingMode::ReadOnly) {
+        return;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    FlushViewOfFile(Data_, 0);
+    if (sync) {
+        FlushFileBuffers(File_);
+    }
+#else
+    if (msync(Data_, Size_, sync ? MS_SYNC : MS_ASYNC) == -1) {
+        LOG_WARNING("Failed to flush {}: {}", Path_, Errno);
+    }
+#endif
+}
+
+void TMappedFile::Close() {
+#if defined(_WIN32) || defined(_WIN64)
+    if (Data_) {
+        UnmapViewOfFile(Data_);
+    }
+    if (Mapping_ != NULL) {
+        CloseHandle(Mapping_);
+    }
+    if (File_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(File_);
+    }
+    Mapping_ = NULL;
+    File_ = INVALID_HANDLE_VALUE;
+#else
+    if (Data_) {
+        munmap(Data_, Size_);
+    }
+    if (Desc_ != -1) {
+        ::close(Desc_);
+    }
+    Desc_ = -1;
+#endif
+    Data_ = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NIpc
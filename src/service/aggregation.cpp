@@ -0,0 +1,473 @@
+#include <service/aggregation.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TAggregate::Add(double value) {
+    if (Count == 0) {
+        Min = Max = value;
+    } else {
+        Min = std::min(Min, value);
+        Max = std::max(Max, value);
+    }
+    Sum += value;
+    SumSquares += value * value;
+    Count++;
+}
+
+void TAggregate::Merge(const TAggregate& other) {
+    if (other.Empty()) {
+        return;
+    }
+    if (Empty()) {
+        *this = other;
+        return;
+    }
+    Min = std::min(Min, other.Min);
+    Max = std::max(Max, other.Max);
+    Sum += other.Sum;
+    SumSquares += other.SumSquares;
+    Count += other.Count;
+}
+
+bool TAggregate::Empty() const {
+    return Count == 0;
+}
+
+double TAggregate::GetAverage() const {
+    return Count ? Sum / Count : NAN;
+}
+
+double TAggregate::GetVariance() const {
+    if (!Count) {
+        return NAN;
+    }
+    double average = Sum / Count;
+    return std::max(0.0, SumSquares / Count - average * average);
+}
+
+double TAggregate::GetStdDev() const {
+    return std::sqrt(GetVariance());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TRollup::TResult TRollup::Add(const TReading& reading) {
+    TResult result;
+
+    if (!Hourly_.Start) {
+        Hourly_.Start = reading.timestamp;
+    }
+    Hourly_.Aggregate.Add(reading.temperature);
+
+    if (*Hourly_.Start >= reading.timestamp - std::chrono::hours(1)) {
+        return result;
+    }
+
+    // Close hourly bucket, its readings move on to the daily one
+    result.Hourly = TReading(reading.timestamp, Hourly_.Aggregate.GetAverage());
+    result.HourlyCount = Hourly_.Aggregate.Count;
+    Daily_.Aggregate.Merge(Hourly_.Aggregate);
+    Hourly_ = {{}, reading.timestamp};
+
+    if (!Daily_.Start) {
+        Daily_.Start = reading.timestamp;
+    }
+
+    if (*Daily_.Start >= reading.timestamp - std::chrono::days(1)) {
+        return result;
+    }
+
+    // Close daily bucket
+    result.Daily = TReading(reading.timestamp, Daily_.Aggregate.GetAverage());
+    result.DailyCount = Daily_.Aggregate.Count;
+    Daily_ = {{}, reading.timestamp};
+
+    return result;
+}
+
+void TRollup::Correct(const TReading& reading, std::optional<TTimePoint> lastHourly, std::optional<TTimePoint> lastDaily) {
+    if (!lastHourly || reading.timestamp > *lastHourly) {
+        Hourly_.Aggregate.Add(reading.temperature);
+    } else if (!lastDaily || reading.timestamp > *lastDaily) {
+        Daily_.Aggregate.Add(reading.temperature);
+    }
+}
+
+double TRollup::CorrectAverage(double average, uint64_t count, double value) {
+    return (average * static_cast<double>(count) + value) / static_cast<double>(count + 1);
+}
+
+const TAggregate& TRollup::GetHourlyBucket() const {
+    return Hourly_.Aggregate;
+}
+
+const TAggregate& TRollup::GetDailyBucket() const {
+    return Daily_.Aggregate;
+}
+
+const TRollup::TBucket& TRollup::GetHourlyState() const {
+    return Hourly_;
+}
+
+const TRollup::TBucket& TRollup::GetDailyState() const {
+    return Daily_;
+}
+
+void TRollup::SetState(const TBucket& hourly, const TBucket& daily) {
+    Hourly_ = hourly;
+    Daily_ = daily;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TLadderLevel::TLadderLevel(TDuration resolution, TDuration retention, double accuracy)
+    : Resolution_(resolution),
+      Retention_(retention),
+      Accuracy_(accuracy)
+{ }
+
+std::optional<TSummary> TLadderLevel::Add(const TReading& reading, bool sketch) {
+    std::optional<TSummary> closed;
+
+    auto start = AlignDown(reading.timestamp);
+    if (!Open_) {
+        Open_ = TSummary{start, {}, TQuantileSketch(Accuracy_)};
+    } else if (start > Open_->Start) {
+        closed = std::move(*Open_);
+        Closed_.push_back(*closed);
+        Open_ = TSummary{start, {}, TQuantileSketch(Accuracy_)};
+    }
+    Open_->Aggregate.Add(reading.temperature);
+    if (sketch) {
+        Open_->Sketch.Add(reading.temperature);
+    }
+
+    auto horizon = AlignDown(reading.timestamp - Retention_);
+    if (horizon > Horizon_) {
+        Horizon_ = horizon;
+        while (!Closed_.empty() && Closed_.front().Start < Horizon_) {
+            Closed_.pop_front();
+        }
+    }
+
+    return closed;
+}
+
+void TLadderLevel::Correct(const TReading& reading, bool sketch) {
+    auto start = AlignDown(reading.timestamp);
+    if (!Open_ || start < Horizon_ || start > Open_->Start) {
+        return;
+    }
+
+    if (start == Open_->Start) {
+        Open_->Aggregate.Add(reading.temperature);
+        if (sketch) {
+            Open_->Sketch.Add(reading.temperature);
+        }
+        return;
+    }
+
+    auto it = std::lower_bound(Closed_.begin(), Closed_.end(), start, [] (const TSummary& summary, auto timestamp) {
+        return summary.Start < timestamp;
+    });
+    bool exists = it != Closed_.end() && it->Start == start;
+
+    auto summary = exists ? *it : TSummary{start, {}, TQuantileSketch(Accuracy_)};
+    summary.Aggregate.Add(reading.temperature);
+    summary.Sketch.Add(reading.temperature);
+
+    if (exists) {
+        Closed_.replace(it, summary);
+    } else {
+        Closed_.insert(it, summary);
+    }
+}
+
+void TLadderLevel::MergeFiner(const TSummary& finer) {
+    auto start = AlignDown(finer.Start);
+    if (!Open_) {
+        Open_ = TSummary{start, {}, TQuantileSketch(Accuracy_)};
+    }
+    if (start == Open_->Start) {
+        Open_->Sketch.Merge(finer.Sketch);
+    }
+}
+
+void TLadderLevel::Rebuild(const TLadderLevel& finer) {
+    auto mergeBucket = [this] (const TSummary& summary, bool sketch) {
+        auto start = AlignDown(summary.Start);
+        if (!Open_ || start > Open_->Start) {
+            if (Open_) {
+                Closed_.push_back(*Open_);
+            }
+            Open_ = TSummary{start, {}, TQuantileSketch(Accuracy_)};
+        }
+        Open_->Aggregate.Merge(summary.Aggregate);
+        if (sketch) {
+            Open_->Sketch.Merge(summary.Sketch);
+        }
+    };
+
+    Closed_ = {};
+    Open_.reset();
+    for (const auto& summary : finer.Closed_) {
+        mergeBucket(summary, true);
+    }
+    // The open finer sketch is merged when that bucket closes.
+    if (finer.Open_) {
+        mergeBucket(*finer.Open_, false);
+    }
+}
+
+void TLadderLevel::ResetOpenSketch(const TLadderLevel& finer) {
+    if (!Open_) {
+        return;
+    }
+    Open_->Sketch = TQuantileSketch(Accuracy_);
+    for (const auto& summary : finer.Closed_) {
+        if (summary.Start >= Open_->Start && summary.Start < Open_->Start + Resolution_) {
+            Open_->Sketch.Merge(summary.Sketch);
+        }
+    }
+}
+
+bool TLadderLevel::IsOpen(TTimePoint timestamp) const {
+    return Open_ && AlignDown(timestamp) == Open_->Start;
+}
+
+TLadderLevel::TDuration TLadderLevel::GetResolution() const {
+    return Resolution_;
+}
+
+TLadderLevel::TDuration TLadderLevel::GetRetention() const {
+    return Retention_;
+}
+
+double TLadderLevel::GetAccuracy() const {
+    return Accuracy_;
+}
+
+const TSummarySequence& TLadderLevel::GetClosed() const {
+    return Closed_;
+}
+
+const std::optional<TSummary>& TLadderLevel::GetOpen() const {
+    return Open_;
+}
+
+TLadderLevel::TTimePoint TLadderLevel::GetHorizon() const {
+    return Horizon_;
+}
+
+TAggregate TLadderLevel::Summarize(TTimePoint from, TTimePoint to) const {
+    TAggregate result;
+
+    auto first = std::lower_bound(Closed_.begin(), Closed_.end(), from, [] (const TSummary& summary, auto timestamp) {
+        return summary.Start < timestamp;
+    });
+    for (auto it = first; it != Closed_.end() && it->Start < to; ++it) {
+        result.Merge(it->Aggregate);
+    }
+
+    if (Open_ && Open_->Start >= from && Open_->Start < to) {
+        result.Merge(Open_->Aggregate);
+    }
+    return result;
+}
+
+void TLadderLevel::MergeSketches(TTimePoint from, TTimePoint to, TQuantileSketch& sketch) const {
+    auto first = std::lower_bound(Closed_.begin(), Closed_.end(), from, [] (const TSummary& summary, auto timestamp) {
+        return summary.Start < timestamp;
+    });
+    for (auto it = first; it != Closed_.end() && it->Start < to; ++it) {
+        sketch.Merge(it->Sketch);
+    }
+
+    if (Open_ && Open_->Start >= from && Open_->Start < to) {
+        sketch.Merge(Open_->Sketch);
+    }
+}
+
+TLadderLevel::TTimePoint TLadderLevel::AlignDown(TTimePoint timestamp) const {
+    auto sinceEpoch = timestamp.time_since_epoch();
+    auto remainder = sinceEpoch % Resolution_;
+    if (remainder < TDuration::zero()) {
+        remainder += Resolution_;
+    }
+    return timestamp - remainder;
+}
+
+TLadderLevel::TTimePoint TLadderLevel::AlignUp(TTimePoint timestamp) const {
+    auto aligned = AlignDown(timestamp);
+    return aligned == timestamp ? aligned : aligned + Resolution_;
+}
+
+void TLadderLevel::SetState(TSummarySequence closed, std::optional<TSummary> open) {
+    Closed_ = std::move(closed);
+    Open_ = std::move(open);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TRollupLadder::TRollupLadder(std::vector<TLadderLevel> levels)
+    : Levels_(std::move(levels))
+{ }
+
+bool TRollupLadder::Add(const TReading& reading) {
+    bool closed = false;
+
+    // Finer to coarser, so that a closed bucket reaches the next level
+    // before the reading can close the bucket it belongs to there.
+    std::optional<TSummary> finer;
+    for (size_t index = 0; index < Levels_.size(); index++) {
+        if (finer) {
+            Levels_[index].MergeFiner(*finer);
+        }
+        finer = Levels_[index].Add(reading, index == 0);
+        closed |= finer.has_value();
+    }
+
+    if (!LastReading_ || reading.timestamp > *LastReading_) {
+        LastReading_ = reading.timestamp;
+    }
+    return closed;
+}
+
+bool TRollupLadder::Correct(const TReading& reading) {
+    bool changed = false;
+    for (size_t index = 0; index < Levels_.size(); index++) {
+        auto& level = Levels_[index];
+        if (!level.GetOpen() || level.AlignDown(reading.timestamp) < level.GetHorizon()) {
+            continue;
+        }
+        // An open finer bucket hands the value on when it closes.
+        bool sketch = index == 0 || !Levels_[index - 1].IsOpen(reading.timestamp);
+        level.Correct(reading, sketch);
+        changed = true;
+    }
+    return changed;
+}
+
+TAggregate TRollupLadder::Summarize(TTimePoint from, TTimePoint to, const TReadingRange& raw) const {
+    TAggregate result;
+    auto oldest = GetOldest(raw);
+    if (!oldest) {
+        return result;
+    }
+
+    Decompose(
+        Levels_.size(),
+        std::max(from, *oldest),
+        to,
+        [&] (size_t index, TTimePoint first, TTimePoint last) {
+            result.Merge(Levels_[index].Summarize(first, last));
+        },
+        [&] (TTimePoint first, TTimePoint last) {
+            for (const auto& reading : raw.Slice(first, last)) {
+                result.Add(reading.temperature);
+            }
+        });
+    return result;
+}
+
+TQuantileSketch TRollupLadder::GetQuantileSketch(TTimePoint from, TTimePoint to, const TReadingRange& raw) const {
+    TQuantileSketch result(Levels_.empty() ? TQuantileSketch::DefaultAccuracy : Levels_.front().GetAccuracy());
+    auto oldest = GetOldest(raw);
+    if (!oldest) {
+        return result;
+    }
+
+    Decompose(
+        Levels_.size(),
+        std::max(from, *oldest),
+        to,
+        [&] (size_t index, TTimePoint first, TTimePoint last) {
+            const auto& level = Levels_[index];
+            level.MergeSketches(first, last, result);
+
+            // The open bucket holds finer buckets that are still open too.
+            const auto& open = level.GetOpen();
+            if (open && open->Start >= first && open->Start < last) {
+                for (size_t finer = 0; finer < index; finer++) {
+                    if (const auto& finerOpen = Levels_[finer].GetOpen()) {
+                        result.Merge(finerOpen->Sketch);
+                    }
+                }
+            }
+        },
+        [&] (TTimePoint first, TTimePoint last) {
+            for (const auto& reading : raw.Slice(first, last)) {
+                result.Add(reading.temperature);
+            }
+        });
+    return result;
+}
+
+std::optional<TRollupLadder::TTimePoint> TRollupLadder::GetOldest(const TReadingRange& raw) const {
+    // Nothing precedes the oldest data point, clamping there also keeps the
+    // alignment arithmetic away from open-ended bounds.
+    std::optional<TTimePoint> oldest;
+    auto consider = [&] (TTimePoint timestamp) {
+        oldest = oldest ? std::min(*oldest, timestamp) : timestamp;
+    };
+    if (!raw.empty()) {
+        consider(raw.front().timestamp);
+    }
+    for (const auto& level : Levels_) {
+        if (!level.GetClosed().empty()) {
+            consider(level.GetClosed().front().Start);
+        } else if (level.GetOpen()) {
+            consider(level.GetOpen()->Start);
+        }
+    }
+    return oldest;
+}
+
+template <typename TOnLevel, typename TOnRaw>
+void TRollupLadder::Decompose(size_t levels, TTimePoint from, TTimePoint to, const TOnLevel& onLevel, const TOnRaw& onRaw) const {
+    if (from >= to) {
+        return;
+    }
+
+    if (levels == 0) {
+        onRaw(from, to);
+        return;
+    }
+
+    const auto& level = Levels_[levels - 1];
+    auto first = level.AlignUp(std::max(from, level.GetHorizon()));
+    auto last = level.AlignDown(to);
+    if (first >= last) {
+        Decompose(levels - 1, from, to, onLevel, onRaw);
+        return;
+    }
+
+    Decompose(levels - 1, from, first, onLevel, onRaw);
+    onLevel(levels - 1, first, last);
+    Decompose(levels - 1, last, to, onLevel, onRaw);
+}
+
+const std::vector<TLadderLevel>& TRollupLadder::GetLevels() const {
+    return Levels_;
+}
+
+std::vector<TLadderLevel>& TRollupLadder::GetLevels() {
+    return Levels_;
+}
+
+std::optional<TRollupLadder::TTimePoint> TRollupLadder::GetLastReading() const {
+    return LastReading_;
+}
+
+void TRollupLadder::SetLastReading(std::optional<TTimePoint> lastReading) {
+    LastReading_ = lastReading;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
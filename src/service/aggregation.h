@@ -0,0 +1,263 @@
+#pragma once
+
+#include <service/reading.h>
+#include <service/sketch.h>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Running summary of an open aggregation bucket, updated on every reading
+// so that closing the bucket does not depend on how many samples it holds.
+struct TAggregate {
+    size_t Count = 0;
+    double Sum = 0;
+    double SumSquares = 0;
+    double Min = 0;
+    double Max = 0;
+
+    void Add(double value);
+    void Merge(const TAggregate& other);
+
+    bool Empty() const;
+    double GetAverage() const;
+
+    // Population variance and standard deviation, NaN when empty.
+    double GetVariance() const;
+    double GetStdDev() const;
+};
+
+// Aggregate of the readings with Start <= timestamp < Start + resolution.
+struct TSummary {
+    std::chrono::system_clock::time_point Start;
+    TAggregate Aggregate;
+    TQuantileSketch Sketch;
+};
+
+using TSummarySequence = NCommon::TPersistentSequence<TSummary>;
+
+// Number of readings behind a closed average, keyed by the average's
+// timestamp, so that late readings can be folded into it.
+struct TBucketCount {
+    std::chrono::system_clock::time_point Timestamp;
+    uint64_t Count = 0;
+};
+
+using TBucketCountSequence = NCommon::TPersistentSequence<TBucketCount>;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Hourly and daily rollup of the raw stream, shared by the storage backends.
+// A bucket is closed by the first reading that comes more than its period
+// after the previous close (or after the bucket start if nothing was closed).
+class TRollup {
+public:
+    using TTimePoint = std::chrono::system_clock::time_point;
+
+    struct TResult {
+        std::optional<TReading> Hourly;
+        std::optional<TReading> Daily;
+        // Readings behind the closed averages.
+        uint64_t HourlyCount = 0;
+        uint64_t DailyCount = 0;
+    };
+
+    TResult Add(const TReading& reading);
+
+    // Counts a reading older than the newest one in the open bucket it
+    // belongs to, given the timestamps of the last closed hourly and daily
+    // buckets. Readings of closed hourly buckets still reach the daily one.
+    void Correct(const TReading& reading, std::optional<TTimePoint> lastHourly, std::optional<TTimePoint> lastDaily);
+
+    // Average of count readings with one more value folded in. Closed
+    // buckets are corrected this way with the count kept for them.
+    static double CorrectAverage(double average, uint64_t count, double value);
+
+    // Rebuilds the open buckets after a restart from the stored tiers.
+    template <typename TRaw, typename THourly, typename TDaily>
+    void Restore(const TRaw& raw, const THourly& hourly, const TDaily& daily);
+
+    const TAggregate& GetHourlyBucket() const;
+    const TAggregate& GetDailyBucket() const;
+
+    struct TBucket {
+        TAggregate Aggregate;
+        std::optional<TTimePoint> Start;
+    };
+
+    // Raw bucket state for checkpoints.
+    const TBucket& GetHourlyState() const;
+    const TBucket& GetDailyState() const;
+    void SetState(const TBucket& hourly, const TBucket& daily);
+
+private:
+    TBucket Hourly_;
+    TBucket Daily_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// One rung of the ladder: summaries of buckets aligned to multiples of the
+// resolution since the epoch, closed buckets older than the retention are
+// dropped. The bucket of the latest reading stays open.
+//
+// Only the finest level puts readings into its sketches, every other level
+// gets the sketches of finer buckets merged in when they close.
+class TLadderLevel {
+public:
+    using TTimePoint = std::chrono::system_clock::time_point;
+    using TDuration = std::chrono::system_clock::duration;
+
+    TLadderLevel(TDuration resolution, TDuration retention, double accuracy = TQuantileSketch::DefaultAccuracy);
+
+    // Returns the bucket closed by the reading, if any. Readings older than
+    // the open bucket are counted in it.
+    std::optional<TSummary> Add(const TReading& reading, bool sketch);
+
+    // Counts a reading older than the newest one in its bucket, which is
+    // created if the reading is the first there. Buckets behind the horizon
+    // are left alone. The open bucket's sketch only gets the value when
+    // sketch is set, closed buckets' sketches are complete and always do.
+    void Correct(const TReading& reading, bool sketch);
+
+    // Adds the sketch of a closed finer bucket to the open bucket.
+    void MergeFiner(const TSummary& finer);
+
+    // Whether the reading falls into the open bucket.
+    bool IsOpen(TTimePoint timestamp) const;
+
+    // Builds the buckets of a level added to an existing ladder from the
+    // summaries of the next finer level.
+    void Rebuild(const TLadderLevel& finer);
+
+    // Re-derives the open bucket's sketch from the closed buckets of a
+    // rebuilt finer level, which will feed this level from now on.
+    void ResetOpenSketch(const TLadderLevel& finer);
+
+    TDuration GetResolution() const;
+    TDuration GetRetention() const;
+    double GetAccuracy() const;
+
+    const TSummarySequence& GetClosed() const;
+    const std::optional<TSummary>& GetOpen() const;
+
+    // Buckets starting before the horizon may have been dropped.
+    TTimePoint GetHorizon() const;
+
+    // Merged summaries of the buckets starting in [from, to).
+    TAggregate Summarize(TTimePoint from, TTimePoint to) const;
+
+    // Merged sketches of the buckets starting in [from, to). The open
+    // bucket's sketch lacks the open finer buckets, see TRollupLadder.
+    void MergeSketches(TTimePoint from, TTimePoint to, TQuantileSketch& sketch) const;
+
+    TTimePoint AlignDown(TTimePoint timestamp) const;
+    TTimePoint AlignUp(TTimePoint timestamp) const;
+
+    void SetState(TSummarySequence closed, std::optional<TSummary> open);
+
+private:
+    TDuration Resolution_;
+    TDuration Retention_;
+    double Accuracy_;
+
+    TSummarySequence Closed_;
+    std::optional<TSummary> Open_;
+    TTimePoint Horizon_ = TTimePoint::min();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Levels of increasing resolution fed by the raw stream. A query is split
+// into the coarsest buckets that fit inside it, and only the edges go to
+// finer levels and finally to the raw readings.
+class TRollupLadder {
+public:
+    using TTimePoint = std::chrono::system_clock::time_point;
+
+    TRollupLadder() = default;
+
+    // Levels must be ordered by resolution, each a multiple of the previous.
+    explicit TRollupLadder(std::vector<TLadderLevel> levels);
+
+    // Returns true if any level closed a bucket.
+    bool Add(const TReading& reading);
+
+    // Updates the buckets a reading older than the last one belongs to in
+    // place, returns true if any level changed.
+    bool Correct(const TReading& reading);
+
+    // Feeds the readings newer than the last one the ladder has seen, this
+    // catches up a ladder loaded from an older file.
+    template <typename TRaw>
+    void Restore(const TRaw& raw);
+
+    // Summary of the readings with from <= timestamp < to.
+    TAggregate Summarize(TTimePoint from, TTimePoint to, const TReadingRange& raw) const;
+
+    // Quantile sketch of the readings with from <= timestamp < to, merged
+    // from bucket sketches the same way.
+    TQuantileSketch GetQuantileSketch(TTimePoint from, TTimePoint to, const TReadingRange& raw) const;
+
+    const std::vector<TLadderLevel>& GetLevels() const;
+    std::vector<TLadderLevel>& GetLevels();
+
+    std::optional<TTimePoint> GetLastReading() const;
+    void SetLastReading(std::optional<TTimePoint> lastReading);
+
+private:
+    std::optional<TTimePoint> GetOldest(const TReadingRange& raw) const;
+
+    // Splits [from, to) into pieces covered by whole buckets of the first
+    // levels, calls onLevel(index, from, to) or onRaw(from, to) for each.
+    template <typename TOnLevel, typename TOnRaw>
+    void Decompose(size_t levels, TTimePoint from, TTimePoint to, const TOnLevel& onLevel, const TOnRaw& onRaw) const;
+
+    std::vector<TLadderLevel> Levels_;
+    std::optional<TTimePoint> LastReading_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename TRaw>
+void TRollupLadder::Restore(const TRaw& raw) {
+    for (const TReading& reading : raw) {
+        if (!LastReading_ || reading.timestamp > *LastReading_) {
+            Add(reading);
+        }
+    }
+}
+
+template <typename TRaw, typename THourly, typename TDaily>
+void TRollup::Restore(const TRaw& raw, const THourly& hourly, const TDaily& daily) {
+    std::optional<TTimePoint> lastHourly;
+    std::optional<TTimePoint> lastDaily;
+    if (!hourly.empty()) {
+        lastHourly = hourly.back().timestamp;
+        Daily_.Start = hourly.front().timestamp;
+    }
+    if (!daily.empty()) {
+        lastDaily = daily.back().timestamp;
+        Daily_.Start = lastDaily;
+    }
+    Hourly_.Start = lastHourly;
+
+    for (const TReading& reading : raw) {
+        if (!lastHourly || reading.timestamp > *lastHourly) {
+            if (!Hourly_.Start) {
+                Hourly_.Start = reading.timestamp;
+            }
+            Hourly_.Aggregate.Add(reading.temperature);
+        } else if (!lastDaily || reading.timestamp > *lastDaily) {
+            Daily_.Aggregate.Add(reading.temperature);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
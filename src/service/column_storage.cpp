@@ -0,0 +1,507 @@
+#include <service/column_storage.h>
+#include <service/text_format.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "ColumnStorage";
+
+constexpr uint64_t ColumnMagic = 0x314C4F4354505354; // "TSPTCOL1"
+constexpr size_t InitialCapacity = 4096;
+
+int64_t ToNanoseconds(std::chrono::system_clock::time_point timestamp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point FromNanoseconds(int64_t nanoseconds) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+}
+
+std::string GetTierName(ETier tier) {
+    switch (tier) {
+        case ETier::Hourly:
+            return "hourly";
+        case ETier::Daily:
+            return "daily";
+        case ETier::Raw:
+        default:
+            return "raw";
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TColumnTier::TColumnTier(const std::filesystem::path& directory, const std::string& name)
+    : TimestampsPath_(directory / (name + ".ts")),
+      ValuesPath_(directory / (name + ".val"))
+{
+    std::filesystem::create_directories(directory);
+
+    if (!Open()) {
+        Rewrite(InitialCapacity);
+    }
+}
+
+size_t TColumnTier::size() const {
+    return End_ - Begin_;
+}
+
+bool TColumnTier::empty() const {
+    return size() == 0;
+}
+
+TReading TColumnTier::operator[](size_t index) const {
+    size_t position = Begin_ + index;
+    return {FromNanoseconds(TimestampData_[position]), ValueData_[position]};
+}
+
+TReading TColumnTier::front() const {
+    return (*this)[0];
+}
+
+TReading TColumnTier::back() const {
+    return (*this)[size() - 1];
+}
+
+TColumnTier::const_iterator TColumnTier::begin() const {
+    return const_iterator(this, 0);
+}
+
+TColumnTier::const_iterator TColumnTier::end() const {
+    return const_iterator(this, size());
+}
+
+std::pair<size_t, size_t> TColumnTier::FindRange(
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) const
+{
+    const int64_t* begin = TimestampData_ + Begin_;
+    const int64_t* end = TimestampData_ + End_;
+    const int64_t* first = std::lower_bound(begin, end, ToNanoseconds(from));
+    const int64_t* last = std::lower_bound(first, end, ToNanoseconds(to));
+    return {first - begin, std::max(first, last) - begin};
+}
+
+TReadingRange TColumnTier::GetRange() const {
+    return TReadingRange(Timestamps_, Values_, TimestampData_, ValueData_, Begin_, End_);
+}
+
+TReadingRange TColumnTier::GetRange(
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) const
+{
+    auto [first, last] = FindRange(from, to);
+    return TReadingRange(
+        Timestamps_,
+        Values_,
+        TimestampData_,
+        ValueData_,
+        Begin_ + first,
+        Begin_ + last);
+}
+
+void TColumnTier::PushBack(const TReading& reading) {
+    if (End_ == Header_->Capacity) {
+        Rewrite(std::max(InitialCapacity, 2 * (size() + 1)));
+    }
+
+    TimestampData_[End_] = ToNanoseconds(reading.timestamp);
+    ValueData_[End_] = reading.temperature;
+    End_++;
+    Header_->Generation++;
+}
+
+void TColumnTier::DropBefore(std::chrono::system_clock::time_point cutoff) {
+    auto cutoffNs = ToNanoseconds(cutoff);
+    auto begin = Begin_;
+    while (begin < End_ && TimestampData_[begin] < cutoffNs) {
+        begin++;
+    }
+    if (begin != Begin_) {
+        Begin_ = begin;
+        Header_->Generation++;
+    }
+}
+
+void TColumnTier::Insert(size_t index, const TReading& reading) {
+    if (index == size()) {
+        PushBack(reading);
+        return;
+    }
+
+    auto capacity = size() < Header_->Capacity ? Header_->Capacity : 2 * (size() + 1);
+    Rewrite(capacity, [&] (int64_t* timestamps, double* values, uint64_t& end) {
+        std::memmove(timestamps + index + 1, timestamps + index, (end - index) * sizeof(int64_t));
+        std::memmove(values + index + 1, values + index, (end - index) * sizeof(double));
+        timestamps[index] = ToNanoseconds(reading.timestamp);
+        values[index] = reading.temperature;
+        end++;
+    });
+}
+
+void TColumnTier::Replace(size_t index, const TReading& reading) {
+    Rewrite(Header_->Capacity, [&] (int64_t* timestamps, double* values, uint64_t& /*end*/) {
+        timestamps[index] = ToNanoseconds(reading.timestamp);
+        values[index] = reading.temperature;
+    });
+}
+
+void TColumnTier::Commit(bool sync) {
+    if (Header_->Begin == Begin_ && Header_->End == End_) {
+        return;
+    }
+
+    // The header must not cover records that may still be missing on disk.
+    if (sync) {
+        Values_->Flush(true);
+        Timestamps_->Flush(true);
+    }
+
+    Header_->Begin = Begin_;
+    Header_->End = End_;
+
+    if (sync) {
+        Timestamps_->Flush(true);
+    }
+}
+
+uint64_t TColumnTier::GetGeneration() const {
+    return Header_->Generation;
+}
+
+TReadingRange TColumnTier::ReadRange(
+    const std::filesystem::path& directory,
+    const std::string& name,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    auto timestampsPath = directory / (name + ".ts");
+    auto valuesPath = directory / (name + ".val");
+    if (!std::filesystem::exists(timestampsPath) || !std::filesystem::exists(valuesPath)) {
+        return TReadingRange();
+    }
+
+    auto timestamps = NCommon::New<NIpc::TMappedFile>(timestampsPath, 0, NIpc::EMappingMode::ReadOnly);
+    auto values = NCommon::New<NIpc::TMappedFile>(valuesPath, 0, NIpc::EMappingMode::ReadOnly);
+    if (!IsValid(*timestamps, *values)) {
+        LOG_WARNING("Column files are damaged, skipping tier (File: {})", timestampsPath);
+        return TReadingRange();
+    }
+
+    const auto* header = static_cast<const THeader*>(std::as_const(*timestamps).GetData());
+    const auto* timestampData = reinterpret_cast<const int64_t*>(static_cast<const char*>(std::as_const(*timestamps).GetData()) + HeaderSize);
+    const auto* valueData = reinterpret_cast<const double*>(static_cast<const char*>(std::as_const(*values).GetData()) + HeaderSize);
+    auto begin = header->Begin;
+    auto end = header->End;
+
+    TReadingRange range(std::move(timestamps), std::move(values), timestampData, valueData, begin, end);
+    return range.Slice(from, to);
+}
+
+bool TColumnTier::IsValid(const NIpc::TMappedFile& timestamps, const NIpc::TMappedFile& values) {
+    if (timestamps.GetSize() < HeaderSize || values.GetSize() < HeaderSize) {
+        return false;
+    }
+
+    const auto* header = static_cast<const THeader*>(timestamps.GetData());
+    const auto* valuesHeader = static_cast<const THeader*>(values.GetData());
+
+    return header->Magic == ColumnMagic
+        && valuesHeader->Magic == ColumnMagic
+        && header->Layout == valuesHeader->Layout
+        && header->Begin <= header->End
+        && header->End <= header->Capacity
+        && timestamps.GetSize() >= HeaderSize + header->Capacity * sizeof(int64_t)
+        && values.GetSize() >= HeaderSize + header->Capacity * sizeof(double);
+}
+
+bool TColumnTier::Open() {
+    FinishRewrite();
+
+    if (!std::filesystem::exists(TimestampsPath_) || !std::filesystem::exists(ValuesPath_)) {
+        return false;
+    }
+
+    auto timestamps = NCommon::New<NIpc::TMappedFile>(TimestampsPath_, HeaderSize);
+    auto values = NCommon::New<NIpc::TMappedFile>(ValuesPath_, HeaderSize);
+
+    if (!IsValid(*timestamps, *values)) {
+        LOG_WARNING("Column files are damaged, starting tier from scratch (File: {})", TimestampsPath_);
+        return false;
+    }
+
+    Attach(std::move(timestamps), std::move(values));
+    LOG_INFO("Column tier opened (File: {}, Records: {})", TimestampsPath_, size());
+    return true;
+}
+
+void TColumnTier::FinishRewrite() {
+    // Rewrite renames the values file first. If it stopped before renaming
+    // the timestamps, the complete temporary timestamps file has the layout
+    // of the new values file and completes the pair.
+    auto timestampsTmp = TimestampsPath_;
+    timestampsTmp += ".tmp";
+    if (!std::filesystem::exists(timestampsTmp) || !std::filesystem::exists(ValuesPath_)) {
+        return;
+    }
+
+    {
+        NIpc::TMappedFile values(ValuesPath_, 0, NIpc::EMappingMode::ReadOnly);
+        if (std::filesystem::exists(TimestampsPath_)) {
+            NIpc::TMappedFile timestamps(TimestampsPath_, 0, NIpc::EMappingMode::ReadOnly);
+            if (IsValid(timestamps, values)) {
+                return;
+            }
+        }
+
+        NIpc::TMappedFile pending(timestampsTmp, 0, NIpc::EMappingMode::ReadOnly);
+        if (!IsValid(pending, values)) {
+            return;
+        }
+    }
+
+    LOG_WARNING("Finishing interrupted column rewrite (File: {})", TimestampsPath_);
+    std::filesystem::rename(timestampsTmp, TimestampsPath_);
+}
+
+void TColumnTier::Rewrite(size_t capacity, const TEdit& edit) {
+    // Live records are copied into fresh files which then replace the old ones,
+    // mappings of the old files stay valid until released.
+    auto timestampsTmp = TimestampsPath_;
+    timestampsTmp += ".tmp";
+    auto valuesTmp = ValuesPath_;
+    valuesTmp += ".tmp";
+
+    std::filesystem::remove(timestampsTmp);
+    std::filesystem::remove(valuesTmp);
+
+    auto timestamps = NCommon::New<NIpc::TMappedFile>(timestampsTmp, HeaderSize + capacity * sizeof(int64_t));
+    auto values = NCommon::New<NIpc::TMappedFile>(valuesTmp, HeaderSize + capacity * sizeof(double));
+
+    THeader header{ColumnMagic, 0, 0, 0, 0, capacity};
+    if (Header_) {
+        header.Layout = Header_->Layout + 1;
+        header.Generation = Header_->Generation + 1;
+        header.End = size();
+
+        std::memcpy(
+            static_cast<char*>(timestamps->GetData()) + HeaderSize,
+            TimestampData_ + Begin_,
+            header.End * sizeof(int64_t));
+        std::memcpy(
+            static_cast<char*>(values->GetData()) + HeaderSize,
+            ValueData_ + Begin_,
+            header.End * sizeof(double));
+    }
+
+    if (edit) {
+        edit(
+            reinterpret_cast<int64_t*>(static_cast<char*>(timestamps->GetData()) + HeaderSize),
+            reinterpret_cast<double*>(static_cast<char*>(values->GetData()) + HeaderSize),
+            header.End);
+    }
+
+    std::memcpy(values->GetData(), &header, sizeof(header));
+    std::memcpy(timestamps->GetData(), &header, sizeof(header));
+
+    // Both files must be complete on disk before they replace the old pair.
+    values->Flush(true);
+    timestamps->Flush(true);
+
+    std::filesystem::rename(valuesTmp, ValuesPath_);
+    std::filesystem::rename(timestampsTmp, TimestampsPath_);
+
+    Attach(std::move(timestamps), std::move(values));
+}
+
+void TColumnTier::Attach(NIpc::TMappedFilePtr timestamps, NIpc::TMappedFilePtr values) {
+    Timestamps_ = std::move(timestamps);
+    Values_ = std::move(values);
+
+    Header_ = static_cast<THeader*>(Timestamps_->GetData());
+    TimestampData_ = reinterpret_cast<int64_t*>(static_cast<char*>(Timestamps_->GetData()) + HeaderSize);
+    ValueData_ = reinterpret_cast<double*>(static_cast<char*>(Values_->GetData()) + HeaderSize);
+    Begin_ = Header_->Begin;
+    End_ = Header_->End;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TColumnStorage::TColumnStorage(NConfig::TColumnStorageConfigPtr config)
+    : Config_(std::move(config)),
+      Raw_(Config_->Path, GetTierName(ETier::Raw)),
+      Hourly_(Config_->Path, GetTierName(ETier::Hourly)),
+      Daily_(Config_->Path, GetTierName(ETier::Daily)),
+      HourlyCounts_(Config_->Path, GetTierName(ETier::Hourly) + "_count"),
+      DailyCounts_(Config_->Path, GetTierName(ETier::Daily) + "_count")
+{
+    Rollup_.Restore(Raw_, Hourly_, Daily_);
+
+    if (Config_->ReorderWindow.count() > 0) {
+        Reorder_.emplace(Config_->ReorderWindow);
+    }
+}
+
+TColumnStorage::~TColumnStorage() {
+    std::lock_guard lock(Lock_);
+    if (Reorder_) {
+        Ready_.clear();
+        Reorder_->Flush(Ready_);
+        Append(Ready_);
+    }
+}
+
+void TColumnStorage::ProcessTemperature(const TReading& reading) {
+    ProcessTemperatures({&reading, 1});
+}
+
+void TColumnStorage::ProcessTemperatures(std::span<const TReading> readings) {
+    std::lock_guard lock(Lock_);
+
+    if (!Reorder_) {
+        Append(readings);
+        return;
+    }
+
+    Ready_.clear();
+    for (const auto& reading : readings) {
+        // Late readings are refused by the buffer and corrected by Append.
+        if (!Reorder_->Push(reading)) {
+            Ready_.push_back(reading);
+            continue;
+        }
+        Reorder_->Pop(Ready_);
+    }
+    Append(Ready_);
+}
+
+void TColumnStorage::Append(std::span<const TReading> readings) {
+    if (readings.empty()) {
+        return;
+    }
+
+    for (const auto& reading : readings) {
+        if (!Raw_.empty() && reading.timestamp < Raw_.back().timestamp) {
+            LOG_DEBUG("Late reading applied as correction (Reading: {})", ReadingToString(reading));
+            Correct(reading);
+            continue;
+        }
+
+        Raw_.PushBack(reading);
+        Raw_.DropBefore(reading.timestamp - RawRetention);
+        Hourly_.DropBefore(reading.timestamp - HourlyRetention);
+        HourlyCounts_.DropBefore(reading.timestamp - HourlyRetention);
+        Daily_.DropBefore(reading.timestamp - DailyRetention);
+        DailyCounts_.DropBefore(reading.timestamp - DailyRetention);
+
+        auto rollup = Rollup_.Add(reading);
+        if (rollup.Hourly) {
+            Hourly_.PushBack(*rollup.Hourly);
+            HourlyCounts_.PushBack({rollup.Hourly->timestamp, static_cast<double>(rollup.HourlyCount)});
+        }
+        if (rollup.Daily) {
+            Daily_.PushBack(*rollup.Daily);
+            DailyCounts_.PushBack({rollup.Daily->timestamp, static_cast<double>(rollup.DailyCount)});
+        }
+    }
+
+    bool sync = Config_->Fsync == NConfig::EFsyncPolicy::Commit;
+    Raw_.Commit(sync);
+    Hourly_.Commit(sync);
+    HourlyCounts_.Commit(sync);
+    Daily_.Commit(sync);
+    DailyCounts_.Commit(sync);
+}
+
+void TColumnStorage::Correct(const TReading& reading) {
+    const auto tick = std::chrono::system_clock::duration(1);
+    const auto end = std::chrono::system_clock::time_point::max();
+
+    if (reading.timestamp >= Raw_.back().timestamp - RawRetention) {
+        // After the readings with the same timestamp, like the file storage.
+        Raw_.Insert(Raw_.FindRange(reading.timestamp + tick, end).first, reading);
+    }
+
+    std::optional<std::chrono::system_clock::time_point> lastHourly;
+    std::optional<std::chrono::system_clock::time_point> lastDaily;
+    if (!Hourly_.empty()) {
+        lastHourly = Hourly_.back().timestamp;
+    }
+    if (!Daily_.empty()) {
+        lastDaily = Daily_.back().timestamp;
+    }
+    Rollup_.Correct(reading, lastHourly, lastDaily);
+
+    // The closed bucket ends at the first average at or after the reading
+    // and starts after the previous one.
+    auto correctAverage = [&] (TColumnTier& tier, TColumnTier& counts) {
+        auto index = tier.FindRange(reading.timestamp, end).first;
+        if (index == tier.size() || index == 0) {
+            return;
+        }
+        auto average = tier[index];
+        auto countIndex = counts.FindRange(average.timestamp, end).first;
+        if (countIndex == counts.size() || counts[countIndex].timestamp != average.timestamp) {
+            return;
+        }
+        auto count = static_cast<uint64_t>(counts[countIndex].temperature);
+        tier.Replace(index, {average.timestamp, TRollup::CorrectAverage(average.temperature, count, reading.temperature)});
+        counts.Replace(countIndex, {average.timestamp, static_cast<double>(count + 1)});
+    };
+    correctAverage(Hourly_, HourlyCounts_);
+    correctAverage(Daily_, DailyCounts_);
+}
+
+TStorageSnapshot TColumnStorage::GetSnapshot() {
+    std::lock_guard lock(Lock_);
+    return TStorageSnapshot(Raw_.GetRange(), Hourly_.GetRange(), Daily_.GetRange());
+}
+
+TReadingRange TColumnStorage::GetRange(
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    std::lock_guard lock(Lock_);
+    return GetTier(tier).GetRange(from, to);
+}
+
+TReadingCursorPtr TColumnStorage::OpenColumnCursor(
+    const NConfig::TColumnStorageConfig& config,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    return std::make_unique<TRangeCursor>(TColumnTier::ReadRange(config.Path, GetTierName(tier), from, to));
+}
+
+const TColumnTier& TColumnStorage::GetTier(ETier tier) const {
+    switch (tier) {
+        case ETier::Hourly:
+            return Hourly_;
+        case ETier::Daily:
+            return Daily_;
+        case ETier::Raw:
+        default:
+            return Raw_;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <service/storage.h>
+#include <service/config.h>
+#include <service/cursor.h>
+#include <service/reorder_buffer.h>
+
+#include <ipc/mapped_file.h>
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// One tier kept as two memory-mapped column files: <name>.ts holds int64
+// nanosecond timestamps and <name>.val holds doubles. Both files start with
+// a 64-byte header, so record i sits at the same offset in each of them.
+// Opening a tier reads the header only, records are served from the page cache.
+class TColumnTier {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TReading;
+        using difference_type = ptrdiff_t;
+        using pointer = void;
+        using reference = TReading;
+
+        const_iterator(const TColumnTier* tier, size_t index)
+            : Tier_(tier), Index_(index)
+        { }
+
+        TReading operator*() const { return (*Tier_)[Index_]; }
+        const_iterator& operator++() { ++Index_; return *this; }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs.Index_ == rhs.Index_; }
+
+    private:
+        const TColumnTier* Tier_;
+        size_t Index_;
+    };
+
+    TColumnTier(const std::filesystem::path& directory, const std::string& name);
+
+    size_t size() const;
+    bool empty() const;
+
+    TReading operator[](size_t index) const;
+    TReading front() const;
+    TReading back() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Positions of the first reading at or after from and of the first
+    // reading at or after to.
+    std::pair<size_t, size_t> FindRange(
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const;
+
+    // Reads the records straight from the mapped columns. The range holds
+    // the mappings, and the records it covers are never written again:
+    // appends go past them and dropping only moves the header. So later
+    // changes of the tier do not affect it.
+    TReadingRange GetRange() const;
+    TReadingRange GetRange(
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const;
+
+    // Changes are visible in the tier at once and reach the header on Commit.
+    void PushBack(const TReading& reading);
+    void DropBefore(std::chrono::system_clock::time_point cutoff);
+
+    // Records in place are never written again, so these copy the tier into
+    // fresh files with the change made, O(n) each.
+    void Insert(size_t index, const TReading& reading);
+    void Replace(size_t index, const TReading& reading);
+
+    // Writes the bounds of the tier into the header. With sync the records
+    // are flushed to disk before the header that covers them, and the header
+    // right after.
+    void Commit(bool sync);
+
+    uint64_t GetGeneration() const;
+
+    // Maps the files of a tier read-only, neither creating nor repairing
+    // them. The range is empty if they are missing or damaged.
+    static TReadingRange ReadRange(
+        const std::filesystem::path& directory,
+        const std::string& name,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+private:
+    struct THeader {
+        uint64_t Magic;
+        uint64_t Layout;        // Bumped on every rewrite, must match in both files
+        uint64_t Generation;    // Bumped on every change
+        uint64_t Begin;
+        uint64_t End;
+        uint64_t Capacity;
+    };
+
+    static constexpr size_t HeaderSize = 64;
+    static_assert(sizeof(THeader) <= HeaderSize);
+
+    static bool IsValid(const NIpc::TMappedFile& timestamps, const NIpc::TMappedFile& values);
+
+    void FinishRewrite();
+    bool Open();
+    // Changes the records copied into the fresh files before they replace
+    // the old ones, may move the end.
+    using TEdit = std::function<void(int64_t* timestamps, double* values, uint64_t& end)>;
+
+    void Rewrite(size_t capacity, const TEdit& edit = TEdit());
+    void Attach(NIpc::TMappedFilePtr timestamps, NIpc::TMappedFilePtr values);
+
+    std::filesystem::path TimestampsPath_;
+    std::filesystem::path ValuesPath_;
+
+    NIpc::TMappedFilePtr Timestamps_;
+    NIpc::TMappedFilePtr Values_;
+
+    THeader* Header_ = nullptr;
+    int64_t* TimestampData_ = nullptr;
+    double* ValueData_ = nullptr;
+
+    // Bounds of the tier, the header holds the committed ones.
+    uint64_t Begin_ = 0;
+    uint64_t End_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class TColumnStorage
+    : public TTemperatureStorage
+{
+public:
+    TColumnStorage(NConfig::TColumnStorageConfigPtr config);
+
+    // Releases the readings held for reordering.
+    ~TColumnStorage();
+
+    // Snapshots and ranges read the mapped columns in place.
+    TStorageSnapshot GetSnapshot() override;
+
+    // Binary search runs on the mapped timestamp column.
+    TReadingRange GetRange(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) override;
+
+    // Streams a tier of a storage with this config without opening it for
+    // writing, so tools may read the files of a running service. Missing
+    // tiers are empty.
+    static TReadingCursorPtr OpenColumnCursor(
+        const NConfig::TColumnStorageConfig& config,
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+    void ProcessTemperature(const TReading& reading) override;
+
+    // Takes the lock once for the whole batch.
+    // Readings older than the newest stored one are applied as corrections
+    // like in the file storage, each rewrites the tiers it changes.
+    void ProcessTemperatures(std::span<const TReading> readings) override;
+
+private:
+    void Append(std::span<const TReading> readings);
+
+    // Inserts a late reading into the raw tier if still within retention and
+    // folds it into the open bucket or the closed average it belongs to.
+    void Correct(const TReading& reading);
+
+    const TColumnTier& GetTier(ETier tier) const;
+
+    NConfig::TColumnStorageConfigPtr Config_;
+
+    std::mutex Lock_;
+    TColumnTier Raw_;
+    TColumnTier Hourly_;
+    TColumnTier Daily_;
+
+    // Readings behind each closed average, at its timestamp.
+    TColumnTier HourlyCounts_;
+    TColumnTier DailyCounts_;
+
+    TRollup Rollup_;
+
+    std::optional<TReorderBuffer> Reorder_;
+    std::vector<TReading> Ready_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,273 @@
+#include <service/compression.h>
+
+#include <common/exception.h>
+
+#include <bit>
+#include <cstring>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+constexpr uint8_t GorillaVersion = 1;
+constexpr size_t HeaderSize = 1 + 8 + 4;
+
+void PutLittleEndian(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t GetLittleEndian(std::string_view data, size_t offset, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t Mask(int bits) {
+    return bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+}
+
+int64_t ToUnits(std::chrono::system_clock::time_point timestamp, int64_t resolution) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+    auto units = ns / resolution;
+    return ns % resolution < 0 ? units - 1 : units;
+}
+
+// Delta-of-delta buckets: control prefix, payload width.
+struct TDodBucket {
+    uint64_t Prefix;
+    int PrefixBits;
+    int ValueBits;
+};
+
+constexpr TDodBucket DodBuckets[] = {
+    {0b10, 2, 7},
+    {0b110, 3, 9},
+    {0b1110, 4, 12},
+    {0b11110, 5, 32},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TGorillaEncoder::TGorillaEncoder(std::chrono::nanoseconds resolution)
+    : Resolution_(resolution.count())
+{
+    ASSERT(Resolution_ > 0, "Gorilla resolution must be positive");
+}
+
+void TGorillaEncoder::Append(const TReading& reading) {
+    WriteTimestamp(ToUnits(reading.timestamp, Resolution_));
+    WriteValue(reading.temperature);
+    Count_++;
+}
+
+size_t TGorillaEncoder::GetCount() const {
+    return Count_;
+}
+
+std::string TGorillaEncoder::Finish() {
+    std::string block;
+    block.reserve(HeaderSize + Bits_.size());
+    block.push_back(static_cast<char>(GorillaVersion));
+    PutLittleEndian(block, static_cast<uint64_t>(Resolution_), 8);
+    PutLittleEndian(block, Count_, 4);
+    block.append(reinterpret_cast<const char*>(Bits_.data()), Bits_.size());
+
+    *this = TGorillaEncoder(std::chrono::nanoseconds(Resolution_));
+    return block;
+}
+
+void TGorillaEncoder::WriteBits(uint64_t value, int bits) {
+    while (bits > 0) {
+        if (BitsUsed_ == 8) {
+            Bits_.push_back(0);
+            BitsUsed_ = 0;
+        }
+        int take = std::min(bits, 8 - BitsUsed_);
+        uint64_t chunk = (value >> (bits - take)) & Mask(take);
+        Bits_.back() |= static_cast<uint8_t>(chunk << (8 - BitsUsed_ - take));
+        BitsUsed_ += take;
+        bits -= take;
+    }
+}
+
+void TGorillaEncoder::WriteTimestamp(int64_t timestamp) {
+    if (Count_ == 0) {
+        WriteBits(static_cast<uint64_t>(timestamp), 64);
+        PrevTimestamp_ = timestamp;
+        PrevDelta_ = 0;
+        return;
+    }
+
+    int64_t delta = timestamp - PrevTimestamp_;
+    int64_t dod = delta - PrevDelta_;
+    PrevTimestamp_ = timestamp;
+    PrevDelta_ = delta;
+
+    if (dod == 0) {
+        WriteBits(0, 1);
+        return;
+    }
+
+    for (const auto& bucket : DodBuckets) {
+        int64_t low = -(int64_t(1) << (bucket.ValueBits - 1)) + 1;
+        int64_t high = int64_t(1) << (bucket.ValueBits - 1);
+        if (dod >= low && dod <= high) {
+            WriteBits(bucket.Prefix, bucket.PrefixBits);
+            WriteBits(static_cast<uint64_t>(dod - low), bucket.ValueBits);
+            return;
+        }
+    }
+
+    WriteBits(0b11111, 5);
+    WriteBits(static_cast<uint64_t>(dod), 64);
+}
+
+void TGorillaEncoder::WriteValue(double value) {
+    uint64_t bits = std::bit_cast<uint64_t>(value);
+
+    if (Count_ == 0) {
+        WriteBits(bits, 64);
+        PrevValue_ = bits;
+        return;
+    }
+
+    uint64_t xored = bits ^ PrevValue_;
+    PrevValue_ = bits;
+
+    if (xored == 0) {
+        WriteBits(0, 1);
+        return;
+    }
+    WriteBits(1, 1);
+
+    int leading = std::min(std::countl_zero(xored), 31);
+    int trailing = std::countr_zero(xored);
+
+    if (PrevLeading_ >= 0 && leading >= PrevLeading_ && trailing >= PrevTrailing_) {
+        // Meaningful bits fit into the previous window
+        WriteBits(0, 1);
+        WriteBits(xored >> PrevTrailing_, 64 - PrevLeading_ - PrevTrailing_);
+        return;
+    }
+
+    int meaningful = 64 - leading - trailing;
+    WriteBits(1, 1);
+    WriteBits(leading, 5);
+    WriteBits(meaningful - 1, 6);
+    WriteBits(xored >> trailing, meaningful);
+
+    PrevLeading_ = leading;
+    PrevTrailing_ = trailing;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TGorillaDecoder::TGorillaDecoder(std::string_view block)
+    : Data_(block)
+{
+    ASSERT(Data_.size() >= HeaderSize, "Gorilla block is truncated ({} bytes)", Data_.size());
+    ASSERT(static_cast<uint8_t>(Data_[0]) == GorillaVersion, "Unknown gorilla block version {}", static_cast<int>(Data_[0]));
+
+    Resolution_ = static_cast<int64_t>(GetLittleEndian(Data_, 1, 8));
+    Count_ = static_cast<uint32_t>(GetLittleEndian(Data_, 9, 4));
+    ASSERT(Resolution_ > 0, "Gorilla block has invalid resolution");
+
+    BitPosition_ = HeaderSize * 8;
+}
+
+size_t TGorillaDecoder::GetCount() const {
+    return Count_;
+}
+
+bool TGorillaDecoder::Next(TReading& reading) {
+    if (Decoded_ == Count_) {
+        return false;
+    }
+
+    int64_t units = ReadTimestamp();
+    double value = ReadValue();
+    Decoded_++;
+
+    reading.timestamp = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(units * Resolution_)));
+    reading.temperature = value;
+    return true;
+}
+
+uint64_t TGorillaDecoder::ReadBits(int bits) {
+    ASSERT(BitPosition_ + bits <= Data_.size() * 8, "Gorilla block is truncated");
+
+    uint64_t value = 0;
+    while (bits > 0) {
+        size_t byte = BitPosition_ / 8;
+        int offset = BitPosition_ % 8;
+        int take = std::min(bits, 8 - offset);
+        uint64_t chunk = (static_cast<uint8_t>(Data_[byte]) >> (8 - offset - take)) & Mask(take);
+        value = (value << take) | chunk;
+        BitPosition_ += take;
+        bits -= take;
+    }
+    return value;
+}
+
+int64_t TGorillaDecoder::ReadTimestamp() {
+    if (Decoded_ == 0) {
+        PrevTimestamp_ = static_cast<int64_t>(ReadBits(64));
+        PrevDelta_ = 0;
+        return PrevTimestamp_;
+    }
+
+    int64_t dod = 0;
+    if (ReadBits(1)) {
+        bool matched = false;
+        for (const auto& bucket : DodBuckets) {
+            if (!ReadBits(1)) {
+                int64_t low = -(int64_t(1) << (bucket.ValueBits - 1)) + 1;
+                dod = static_cast<int64_t>(ReadBits(bucket.ValueBits)) + low;
+                matched = true;
+                break;
+            }
+        }
+        if (!matched) {
+            dod = static_cast<int64_t>(ReadBits(64));
+        }
+    }
+
+    PrevDelta_ += dod;
+    PrevTimestamp_ += PrevDelta_;
+    return PrevTimestamp_;
+}
+
+double TGorillaDecoder::ReadValue() {
+    if (Decoded_ == 0) {
+        PrevValue_ = ReadBits(64);
+        return std::bit_cast<double>(PrevValue_);
+    }
+
+    if (ReadBits(1)) {
+        if (ReadBits(1)) {
+            PrevLeading_ = static_cast<int>(ReadBits(5));
+            int meaningful = static_cast<int>(ReadBits(6)) + 1;
+            PrevTrailing_ = 64 - PrevLeading_ - meaningful;
+        }
+        int meaningful = 64 - PrevLeading_ - PrevTrailing_;
+        PrevValue_ ^= ReadBits(meaningful) << PrevTrailing_;
+    }
+
+    return std::bit_cast<double>(PrevValue_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <service/reading.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Gorilla-style block of readings (Pelkonen et al., VLDB 2015).
+// Timestamps are stored as delta-of-delta in multiples of the block resolution,
+// temperatures as XOR against the previous value with a reused bit window.
+//
+// Layout: uint8 version, uint64 resolution (ns), uint32 count, bit stream.
+class TGorillaEncoder {
+public:
+    explicit TGorillaEncoder(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1));
+
+    void Append(const TReading& reading);
+
+    size_t GetCount() const;
+
+    // Returns the encoded block and resets the encoder.
+    std::string Finish();
+
+private:
+    void WriteBits(uint64_t value, int bits);
+    void WriteTimestamp(int64_t timestamp);
+    void WriteValue(double value);
+
+    int64_t Resolution_;
+    uint32_t Count_ = 0;
+
+    std::vector<uint8_t> Bits_;
+    int BitsUsed_ = 8;
+
+    int64_t PrevTimestamp_ = 0;
+    int64_t PrevDelta_ = 0;
+    uint64_t PrevValue_ = 0;
+    int PrevLeading_ = -1;
+    int PrevTrailing_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class TGorillaDecoder {
+public:
+    // Throws if the block header is malformed.
+    explicit TGorillaDecoder(std::string_view block);
+
+    size_t GetCount() const;
+
+    // Returns false when the block is exhausted.
+    bool Next(TReading& reading);
+
+private:
+    uint64_t ReadBits(int bits);
+    int64_t ReadTimestamp();
+    double ReadValue();
+
+    std::string_view Data_;
+    size_t BitPosition_ = 0;
+
+    int64_t Resolution_;
+    uint32_t Count_;
+    uint32_t Decoded_ = 0;
+
+    int64_t PrevTimestamp_ = 0;
+    int64_t PrevDelta_ = 0;
+    uint64_t PrevValue_ = 0;
+    int PrevLeading_ = 0;
+    int PrevTrailing_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Splits readings into blocks of at most blockSize readings each.
+template <typename TContainer>
+std::vector<std::string> EncodeGorillaBlocks(
+    const TContainer& readings,
+    size_t blockSize = 1024,
+    std::chrono::nanoseconds resolution = std::chrono::milliseconds(1))
+{
+    std::vector<std::string> blocks;
+    TGorillaEncoder encoder(resolution);
+    for (const TReading& reading : readings) {
+        encoder.Append(reading);
+        if (encoder.GetCount() == blockSize) {
+            blocks.push_back(encoder.Finish());
+        }
+    }
+    if (encoder.GetCount()) {
+        blocks.push_back(encoder.Finish());
+    }
+    return blocks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
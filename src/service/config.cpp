@@ -4,6 +4,20 @@
 
 namespace NConfig {
 
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+EFsyncPolicy ParseFsyncPolicy(const std::string& fsync) {
+    if (fsync == "never") return EFsyncPolicy::Never;
+    if (fsync == "commit") return EFsyncPolicy::Commit;
+    THROW("Unknown fsync policy: {}", fsync);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void TSimulatorConfig::Load(const nlohmann::json& data) {
@@ -14,16 +28,124 @@ void TSimulatorConfig::Load(const nlohmann::json& data) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void TStorageWriterConfig::Load(const nlohmann::json& data) {
+    CommitInterval = std::chrono::milliseconds(TConfigBase::Load<int64_t>(data, "commit_interval_ms", CommitInterval.count()));
+    MaxBatchSize = TConfigBase::Load<size_t>(data, "max_batch_size", MaxBatchSize);
+
+    Fsync = ParseFsyncPolicy(TConfigBase::Load<std::string>(data, "fsync", "never"));
+
+    ASSERT(CommitInterval.count() >= 0, "Commit interval must not be negative");
+    ASSERT(MaxBatchSize > 0, "Max batch size must be positive");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TJournalConfig::Load(const nlohmann::json& data) {
+    Path = TConfigBase::LoadRequired<std::string>(data, "path");
+    CheckpointInterval = std::chrono::seconds(TConfigBase::Load<int64_t>(data, "checkpoint_interval", CheckpointInterval.count()));
+    CheckpointRecords = TConfigBase::Load<size_t>(data, "checkpoint_records", CheckpointRecords);
+
+    ASSERT(CheckpointInterval.count() > 0, "Checkpoint interval must be positive");
+    ASSERT(CheckpointRecords > 0, "Checkpoint records must be positive");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TLadderLevelConfig::Load(const nlohmann::json& data) {
+    Resolution = std::chrono::seconds(TConfigBase::LoadRequired<int64_t>(data, "resolution"));
+    Retention = std::chrono::seconds(TConfigBase::LoadRequired<int64_t>(data, "retention"));
+
+    ASSERT(Resolution.count() > 0, "Ladder resolution must be positive");
+    ASSERT(Retention >= Resolution, "Ladder retention must cover at least one bucket");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TLadderConfig::Load(const nlohmann::json& data) {
+    Path = TConfigBase::LoadRequired<std::string>(data, "path");
+    SketchAccuracy = TConfigBase::Load<double>(data, "sketch_accuracy", SketchAccuracy);
+    ASSERT(SketchAccuracy > 0 && SketchAccuracy < 1, "Sketch accuracy must be in (0, 1)");
+
+    ASSERT(data.contains("levels") && data["levels"].is_array() && !data["levels"].empty(),
+        "Ladder config requires a non-empty 'levels' array");
+    for (const auto& levelData : data["levels"]) {
+        auto level = NCommon::New<TLadderLevelConfig>();
+        level->Load(levelData);
+        if (!Levels.empty()) {
+            auto previous = Levels.back()->Resolution;
+            ASSERT(level->Resolution > previous && level->Resolution.count() % previous.count() == 0,
+                "Ladder resolutions must grow, each a multiple of the previous ({}s after {}s)",
+                level->Resolution.count(), previous.count());
+        }
+        Levels.push_back(level);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void TFileStorageConfig::Load(const nlohmann::json& data) {
     TemperaturePath = TConfigBase::LoadRequired<std::string>(data, "temperature");
     TemperatureHourPath = TConfigBase::LoadRequired<std::string>(data, "hourly");
     TemperatureDayPath = TConfigBase::LoadRequired<std::string>(data, "daily");
+
+    std::string rawFormat = TConfigBase::Load<std::string>(data, "raw_format", "text");
+    if (rawFormat == "text") RawFormat = ERawStorageFormat::Text;
+    else if (rawFormat == "segments") RawFormat = ERawStorageFormat::Segments;
+    else THROW("Unknown raw storage format: {}", rawFormat);
+
+    std::string fileFormat = TConfigBase::Load<std::string>(data, "file_format", "text");
+    if (fileFormat == "text") FileFormat = ETierFileFormat::Text;
+    else if (fileFormat == "gorilla") FileFormat = ETierFileFormat::Gorilla;
+    else THROW("Unknown tier file format: {}", fileFormat);
+
+    SegmentDuration = std::chrono::seconds(TConfigBase::Load<int64_t>(data, "segment_duration", SegmentDuration.count()));
+    ASSERT(SegmentDuration.count() > 0, "Segment duration must be positive");
+
+    if (data.contains("sample_interval_ms")) {
+        SampleInterval = std::chrono::milliseconds(TConfigBase::LoadRequired<int64_t>(data, "sample_interval_ms"));
+        ASSERT(SampleInterval->count() >= 0, "Sample interval must not be negative");
+    }
+
+    ReorderWindow = std::chrono::milliseconds(TConfigBase::Load<int64_t>(data, "reorder_window_ms", ReorderWindow.count()));
+    ASSERT(ReorderWindow.count() >= 0, "Reorder window must not be negative");
+
+    if (data.contains("writer")) {
+        WriterConfig = TConfigBase::LoadRequired<TStorageWriterConfig>(data, "writer");
+    }
+
+    if (data.contains("journal")) {
+        JournalConfig = TConfigBase::LoadRequired<TJournalConfig>(data, "journal");
+    }
+
+    if (data.contains("ladder")) {
+        LadderConfig = TConfigBase::LoadRequired<TLadderConfig>(data, "ladder");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TColumnStorageConfig::Load(const nlohmann::json& data) {
+    Path = TConfigBase::LoadRequired<std::string>(data, "path");
+
+    ReorderWindow = std::chrono::milliseconds(TConfigBase::Load<int64_t>(data, "reorder_window_ms", ReorderWindow.count()));
+    ASSERT(ReorderWindow.count() >= 0, "Reorder window must not be negative");
+
+    Fsync = ParseFsyncPolicy(TConfigBase::Load<std::string>(data, "fsync", "never"));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void TStorageConfig::Load(const nlohmann::json& data) {
-    FileStorageConfig = TConfigBase::LoadRequired<NConfig::TFileStorageConfig>(data, "file_system");
+    ASSERT(data.contains("file_system") != data.contains("columnar"),
+        "Storage config requires exactly one of 'file_system' and 'columnar'");
+
+    if (data.contains("columnar")) {
+        ColumnStorageConfig = TConfigBase::LoadRequired<NConfig::TColumnStorageConfig>(data, "columnar");
+    } else {
+        FileStorageConfig = TConfigBase::LoadRequired<NConfig::TFileStorageConfig>(data, "file_system");
+    }
+
+    Sensors = TConfigBase::Load<std::vector<std::string>>(data, "sensors", std::vector<std::string>());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -54,6 +176,11 @@ void TConfig::Load(const nlohmann::json& data) {
 
     SerialConfig = TConfigBase::LoadRequired<NIpc::TSerialConfig>(data, "serial");
     StorageConfig = TConfigBase::LoadRequired<TStorageConfig>(data, "storage");
+
+    auto& fileStorageConfig = StorageConfig->FileStorageConfig;
+    if (fileStorageConfig && !fileStorageConfig->SampleInterval) {
+        fileStorageConfig->SampleInterval = std::chrono::milliseconds(MesureDelay);
+    }
 }
 
 } // namespace NConfig
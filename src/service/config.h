@@ -8,7 +8,9 @@
 
 #include <nlohmann/json.hpp>
 
+#include <chrono>
 #include <filesystem>
+#include <optional>
 
 namespace NConfig {
 
@@ -28,6 +30,80 @@ DECLARE_REFCOUNTED(TSimulatorConfig);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+enum class EFsyncPolicy {
+    Never,      // Leave flushing to the OS (default)
+    Commit      // fsync every file touched by a commit
+};
+
+// Background writer of the file storage, see TStorageWriter.
+struct TStorageWriterConfig
+    : public NCommon::TConfigBase
+{
+    std::chrono::milliseconds CommitInterval = std::chrono::milliseconds(1000);
+    size_t MaxBatchSize = 256;
+    EFsyncPolicy Fsync = EFsyncPolicy::Never;
+
+    void Load(const nlohmann::json& data) override;
+};
+
+DECLARE_REFCOUNTED(TStorageWriterConfig);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Write-ahead log with periodic checkpoints, see TJournal.
+struct TJournalConfig
+    : public NCommon::TConfigBase
+{
+    std::filesystem::path Path;
+    std::chrono::seconds CheckpointInterval = std::chrono::minutes(10);
+    size_t CheckpointRecords = 100000;
+
+    void Load(const nlohmann::json& data) override;
+};
+
+DECLARE_REFCOUNTED(TJournalConfig);
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct TLadderLevelConfig
+    : public NCommon::TConfigBase
+{
+    std::chrono::seconds Resolution;
+    std::chrono::seconds Retention;
+
+    void Load(const nlohmann::json& data) override;
+};
+
+DECLARE_REFCOUNTED(TLadderLevelConfig);
+
+// Summary tiers (count, sum, sum of squares, min, max and a quantile sketch
+// per bucket), see TRollupLadder. Levels go from the finest to the coarsest.
+struct TLadderConfig
+    : public NCommon::TConfigBase
+{
+    std::filesystem::path Path;
+    std::vector<TLadderLevelConfigPtr> Levels;
+
+    // Relative error of the per-bucket quantile sketches.
+    double SketchAccuracy = 0.01;
+
+    void Load(const nlohmann::json& data) override;
+};
+
+DECLARE_REFCOUNTED(TLadderConfig);
+
+////////////////////////////////////////////////////////////////////////////////
+
+enum class ERawStorageFormat {
+    Text,       // Whole raw tier rewritten as one file in FileFormat (default)
+    Segments    // Append-only binary segments, TemperaturePath is a directory
+};
+
+enum class ETierFileFormat {
+    Text,       // One "YYYY-MM-DDTHH:MM:SSZ value" line per reading (default)
+    Gorilla     // Length-prefixed gorilla-compressed blocks
+};
+
 struct TFileStorageConfig
     : public NCommon::TConfigBase
 {
@@ -35,6 +111,26 @@ struct TFileStorageConfig
     std::filesystem::path TemperatureHourPath;
     std::filesystem::path TemperatureDayPath;
 
+    ERawStorageFormat RawFormat = ERawStorageFormat::Text;
+    ETierFileFormat FileFormat = ETierFileFormat::Text;
+    std::chrono::seconds SegmentDuration = std::chrono::hours(1);
+
+    // Expected time between readings, used to preallocate the raw tier.
+    // Taken from the measurement delay when unset, zero disables it.
+    std::optional<std::chrono::milliseconds> SampleInterval;
+
+    // Readings are held this long to be put in timestamp order, see
+    // TReorderBuffer. Readings later than that are applied as corrections.
+    std::chrono::milliseconds ReorderWindow = std::chrono::milliseconds(0);
+
+    // Files are written on the ingest thread when unset.
+    TStorageWriterConfigPtr WriterConfig;
+
+    // When set, tier files are only refreshed on checkpoints.
+    TJournalConfigPtr JournalConfig;
+
+    TLadderConfigPtr LadderConfig;
+
     void Load(const nlohmann::json& data) override;
 };
 
@@ -42,11 +138,37 @@ DECLARE_REFCOUNTED(TFileStorageConfig);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+struct TColumnStorageConfig
+    : public NCommon::TConfigBase
+{
+    std::filesystem::path Path;
+
+    // Readings are held this long to be put in timestamp order, see
+    // TReorderBuffer. Readings later than that are dropped.
+    std::chrono::milliseconds ReorderWindow = std::chrono::milliseconds(0);
+
+    // With Commit every batch is synced to disk before the tier headers
+    // are updated to cover it.
+    EFsyncPolicy Fsync = EFsyncPolicy::Never;
+
+    void Load(const nlohmann::json& data) override;
+};
+
+DECLARE_REFCOUNTED(TColumnStorageConfig);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Exactly one of the backends is configured.
 struct TStorageConfig
     : public NCommon::TConfigBase
 {
     TFileStorageConfigPtr FileStorageConfig;
-    
+    TColumnStorageConfigPtr ColumnStorageConfig;
+
+    // Sensors opened at startup by the sharded storage, others are opened
+    // on their first reading.
+    std::vector<std::string> Sensors;
+
     void Load(const nlohmann::json& data) override;
 };
 
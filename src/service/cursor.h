@@ -0,0 +1,51 @@
+#pragma once
+
+#include <service/reading.h>
+
+#include <memory>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Pull-based scan over stored readings, oldest first. Cursors decode their
+// source a block at a time, so memory use does not grow with the number of
+// readings scanned.
+class TReadingCursor {
+public:
+    virtual ~TReadingCursor() = default;
+
+    // Returns false when the scan is over.
+    virtual bool Next(TReading& reading) = 0;
+};
+
+using TReadingCursorPtr = std::unique_ptr<TReadingCursor>;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Walks a range held in memory. The range shares chunks with the cache it
+// was sliced from, nothing is copied.
+class TRangeCursor
+    : public TReadingCursor
+{
+public:
+    explicit TRangeCursor(TReadingRange range)
+        : Range_(std::move(range))
+    { }
+
+    bool Next(TReading& reading) override {
+        if (Index_ == Range_.size()) {
+            return false;
+        }
+        reading = Range_[Index_++];
+        return true;
+    }
+
+private:
+    TReadingRange Range_;
+    size_t Index_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,92 @@
+#include <service/downsample.h>
+
+#include <cmath>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<TReading> DownsampleLttb(const TReadingRange& range, size_t maxPoints) {
+    size_t size = range.size();
+    if (size <= maxPoints || size <= 2) {
+        return std::vector<TReading>(range.begin(), range.end());
+    }
+
+    std::vector<TReading> result;
+    if (maxPoints == 0) {
+        return result;
+    }
+    result.reserve(maxPoints);
+
+    result.push_back(range.front());
+    if (maxPoints == 1) {
+        return result;
+    }
+    if (maxPoints == 2) {
+        result.push_back(range.back());
+        return result;
+    }
+
+    // Seconds since the first reading keep the areas well-conditioned.
+    auto origin = range.front().timestamp;
+    auto x = [origin] (const TReading& reading) {
+        return std::chrono::duration<double>(reading.timestamp - origin).count();
+    };
+
+    // Readings between the first and the last one are split into buckets
+    // [BucketBegin(i), BucketBegin(i + 1)).
+    // Every bucket is non-empty since there are more readings than buckets.
+    size_t buckets = maxPoints - 2;
+    auto bucketBegin = [&] (size_t bucket) {
+        return 1 + bucket * (size - 2) / buckets;
+    };
+
+    auto it = range.begin() + 1;
+    double previousX = 0;
+    double previousY = range.front().temperature;
+
+    for (size_t bucket = 0; bucket < buckets; bucket++) {
+        auto end = range.begin() + bucketBegin(bucket + 1);
+
+        // Mean of the next bucket, the last reading stands in for it at the end.
+        double nextX = 0;
+        double nextY = 0;
+        if (bucket + 1 < buckets) {
+            auto nextEnd = range.begin() + bucketBegin(bucket + 2);
+            for (auto next = end; next != nextEnd; ++next) {
+                nextX += x(*next);
+                nextY += next->temperature;
+            }
+            auto count = static_cast<double>(nextEnd - end);
+            nextX /= count;
+            nextY /= count;
+        } else {
+            nextX = x(range.back());
+            nextY = range.back().temperature;
+        }
+
+        auto picked = it;
+        double maxArea = -1;
+        for (; it != end; ++it) {
+            // Twice the triangle area, the factor does not change the pick.
+            double area = std::abs(
+                (previousX - nextX) * (it->temperature - previousY)
+                - (previousX - x(*it)) * (nextY - previousY));
+            if (area > maxArea) {
+                maxArea = area;
+                picked = it;
+            }
+        }
+
+        result.push_back(*picked);
+        previousX = x(*picked);
+        previousY = picked->temperature;
+    }
+
+    result.push_back(range.back());
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
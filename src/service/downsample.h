@@ -0,0 +1,24 @@
+#pragma once
+
+#include <service/reading.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Largest-Triangle-Three-Buckets: picks at most maxPoints readings that keep
+// the visual shape of the series. The first and last readings are kept, the
+// rest is split into equal buckets and each contributes the reading forming
+// the largest triangle with the previous pick and the next bucket's mean,
+// so spikes survive where plain averaging would flatten them.
+//
+// One pass over the range, the readings are not copied beforehand. Ranges
+// with no more than maxPoints readings are returned as they are.
+std::vector<TReading> DownsampleLttb(const TReadingRange& range, size_t maxPoints);
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -1,4 +1,12 @@
 #include <service/file_storage.h>
+#include <service/compression.h>
+#include <service/text_format.h>
+
+#include <ipc/file_sync.h>
+#include <ipc/mapped_file.h>
+
+#include <algorithm>
+#include <cstring>
 
 namespace NService {
 
@@ -8,165 +16,911 @@ namespace {
 
 inline const std::string LoggingSource = "FileStorage";
 
-#ifdef _WIN32
-time_t timegm(struct tm* tm) {
-    _tzset();
-    return _mkgmtime(tm);
+std::vector<TReading> ParseGorillaReadings(std::string_view data, const std::filesystem::path& file) {
+    std::vector<TReading> readings;
+    uint32_t size;
+    while (data.size() >= sizeof(size)) {
+        std::memcpy(&size, data.data(), sizeof(size));
+        data.remove_prefix(sizeof(size));
+        if (size > data.size()) {
+            LOG_WARNING("Truncated block at the end of file (File: {})", file);
+            break;
+        }
+
+        TGorillaDecoder decoder(data.substr(0, size));
+        data.remove_prefix(size);
+
+        readings.reserve(readings.size() + decoder.GetCount());
+        TReading reading;
+        while (decoder.Next(reading)) {
+            readings.push_back(reading);
+        }
+    }
+    return readings;
 }
-#endif
 
-std::string ReadingToString(TReading reading) {
-    auto time = std::chrono::system_clock::to_time_t(reading.timestamp);
-    std::ostringstream oss;
-    oss << std::put_time(gmtime(&time), "%Y-%m-%dT%H:%M:%SZ") << " "
-        << std::fixed << std::setprecision(std::numeric_limits<double>::digits10 + 1)
-        << reading.temperature;
-    return oss.str();
+std::vector<TReading> ParseTextReadings(std::string_view data, const std::filesystem::path& file) {
+    std::vector<TReading> readings;
+    // A line is about 40 bytes.
+    readings.reserve(data.size() / 32 + 1);
+
+    size_t malformed = 0;
+    while (!data.empty()) {
+        auto end = data.find('\n');
+        auto line = data.substr(0, end);
+        data.remove_prefix(end == std::string_view::npos ? data.size() : end + 1);
+
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+        if (auto reading = ParseReading(line)) {
+            readings.push_back(*reading);
+        } else {
+            malformed++;
+        }
+    }
+
+    if (malformed) {
+        LOG_WARNING("Skipped malformed lines (File: {}, Count: {})", file, malformed);
+    }
+    return readings;
 }
 
-TReading StringToReading(const std::string& str) {
-    std::istringstream iss(str);
-    std::tm tm = {};
-    std::string datetime;
-    double temp;
-    iss >> datetime >> temp;
-    
-    std::istringstream dtstream(datetime);
-    dtstream >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
-    tm.tm_isdst = 0;
-    time_t timestamp = timegm(&tm);
-    
-    return {
-        std::chrono::system_clock::from_time_t(timestamp),
-        temp
-    };
+void WriteGorillaReadings(std::ostream& out, const TReadingSequence& data) {
+    for (const auto& block : EncodeGorillaBlocks(data)) {
+        uint32_t size = block.size();
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.write(block.data(), block.size());
+    }
 }
 
-std::deque<TReading> ReadingsFromFile(const std::filesystem::path& file) {
-    std::deque<TReading> data;
+void WriteTextReadings(std::ostream& out, const TReadingSequence& data) {
+    constexpr size_t ChunkSize = 64 * 1024;
+    std::vector<char> chunk(ChunkSize);
+    char* end = chunk.data();
+
+    TReadingFormatter formatter;
+    for (const auto& reading : data) {
+        if (chunk.data() + ChunkSize - end <= static_cast<ptrdiff_t>(TReadingFormatter::MaxLength)) {
+            out.write(chunk.data(), end - chunk.data());
+            end = chunk.data();
+        }
+        end = formatter.Format(reading, end);
+        *end++ = '\n';
+    }
+    out.write(chunk.data(), end - chunk.data());
+}
+
+// The file is mapped and parsed in place, readings come out in time order.
+TReadingSequence ReadingsFromFile(const std::filesystem::path& file, NConfig::ETierFileFormat format) {
+    std::vector<TReading> readings;
     try {
-        std::fstream fin(file, std::ios::in);
-        std::string str;
-        while (std::getline(fin, str)) {
-            data.emplace_front(StringToReading(str));
+        if (!std::filesystem::exists(file)) {
+            return {};
         }
+
+        auto mapping = NCommon::New<NIpc::TMappedFile>(file, 0, NIpc::EMappingMode::ReadOnly);
+        std::string_view data(static_cast<const char*>(mapping->GetData()), mapping->GetSize());
+
+        readings = format == NConfig::ETierFileFormat::Gorilla
+            ? ParseGorillaReadings(data, file)
+            : ParseTextReadings(data, file);
     } catch (std::exception& ex) {
         LOG_WARNING("Failed to read file with readings (File: {}, Exception: {})", file, ex);
     }
-    return data;
+
+    // Older versions loaded text tiers reversed and could write them back so.
+    auto byTime = [] (const TReading& lhs, const TReading& rhs) {
+        return lhs.timestamp < rhs.timestamp;
+    };
+    if (!std::is_sorted(readings.begin(), readings.end(), byTime)) {
+        if (std::is_sorted(readings.rbegin(), readings.rend(), byTime)) {
+            std::reverse(readings.begin(), readings.end());
+        } else {
+            std::stable_sort(readings.begin(), readings.end(), byTime);
+        }
+    }
+
+    return TReadingSequence(readings);
 }
 
-void ReadingsToFile(const std::filesystem::path& file, const std::deque<TReading>& data) {
+// The file is written aside and renamed over the old one, so a crash leaves
+// either the old or the new contents.
+void ReadingsToFile(const std::filesystem::path& file, const TReadingSequence& data, NConfig::ETierFileFormat format, bool sync) {
+    auto tmpFile = file;
+    tmpFile += ".tmp";
+
     try {
         std::filesystem::create_directory(file.parent_path());
-        std::fstream fout(file, std::ios::out);
-        for (const auto& reading : data) {
-            fout << ReadingToString(reading) << '\n';
+        {
+            if (format == NConfig::ETierFileFormat::Gorilla) {
+                std::ofstream fout(tmpFile, std::ios::out | std::ios::trunc | std::ios::binary);
+                WriteGorillaReadings(fout, data);
+                ASSERT(fout.flush(), "Failed to write {}", tmpFile);
+            } else {
+                std::ofstream fout(tmpFile, std::ios::out | std::ios::trunc);
+                WriteTextReadings(fout, data);
+                ASSERT(fout.flush(), "Failed to write {}", tmpFile);
+            }
         }
+        if (sync) {
+            NIpc::SyncFile(tmpFile);
+        }
+        std::filesystem::rename(tmpFile, file);
     } catch (std::exception& ex) {
         LOG_WARNING("Failed to write readings to file (File: {}, Exception: {})", file, ex);
     }
 }
 
+// Reads a text tier a buffer at a time, a line cut by the buffer end is
+// moved to the front before the next read. The file is expected in time
+// order, as the storage writes it, so the scan stops at the first reading
+// past the range.
+class TTextFileCursor
+    : public TReadingCursor
+{
+public:
+    TTextFileCursor(
+        const std::filesystem::path& file,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to)
+        : File_(file),
+          Input_(file, std::ios::in | std::ios::binary),
+          Buffer_(BufferSize),
+          From_(from),
+          To_(to)
+    {
+        Eof_ = !Input_.is_open();
+    }
+
+    bool Next(TReading& reading) override {
+        while (!Done_) {
+            auto end = Data_.find('\n');
+            if (end == std::string_view::npos && !Eof_) {
+                Refill();
+                continue;
+            }
+            if (Data_.empty()) {
+                Finish();
+                break;
+            }
+
+            auto line = Data_.substr(0, end);
+            Data_.remove_prefix(end == std::string_view::npos ? Data_.size() : end + 1);
+            if (line.empty() || line == "\r") {
+                continue;
+            }
+
+            auto parsed = ParseReading(line);
+            if (!parsed) {
+                Malformed_++;
+            } else if (parsed->timestamp >= To_) {
+                Finish();
+            } else if (parsed->timestamp >= From_) {
+                reading = *parsed;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static constexpr size_t BufferSize = 64 * 1024;
+
+    void Refill() {
+        size_t kept = Data_.size();
+        if (kept) {
+            std::memmove(Buffer_.data(), Data_.data(), kept);
+        }
+        if (kept == Buffer_.size()) {
+            // No line is that long unless the file is damaged.
+            Buffer_.resize(2 * Buffer_.size());
+        }
+        Input_.read(Buffer_.data() + kept, Buffer_.size() - kept);
+        Data_ = std::string_view(Buffer_.data(), kept + Input_.gcount());
+        Eof_ = !Input_;
+    }
+
+    void Finish() {
+        Done_ = true;
+        if (Malformed_) {
+            LOG_WARNING("Skipped malformed lines (File: {}, Count: {})", File_, Malformed_);
+        }
+    }
+
+    std::filesystem::path File_;
+    std::ifstream Input_;
+    std::vector<char> Buffer_;
+    std::string_view Data_;
+    bool Eof_ = false;
+    bool Done_ = false;
+    size_t Malformed_ = 0;
+
+    std::chrono::system_clock::time_point From_;
+    std::chrono::system_clock::time_point To_;
+};
+
+// Reads a gorilla tier one block at a time into a reused buffer.
+class TGorillaFileCursor
+    : public TReadingCursor
+{
+public:
+    TGorillaFileCursor(
+        const std::filesystem::path& file,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to)
+        : File_(file),
+          Input_(file, std::ios::in | std::ios::binary),
+          From_(from),
+          To_(to)
+    { }
+
+    bool Next(TReading& reading) override {
+        try {
+            while (!Done_) {
+                if (!Decoder_ || !Decoder_->Next(reading)) {
+                    NextBlock();
+                    continue;
+                }
+                if (reading.timestamp >= To_) {
+                    Done_ = true;
+                } else if (reading.timestamp >= From_) {
+                    return true;
+                }
+            }
+        } catch (std::exception& ex) {
+            LOG_WARNING("Failed to read file with readings (File: {}, Exception: {})", File_, ex);
+            Done_ = true;
+        }
+        return false;
+    }
+
+private:
+    void NextBlock() {
+        Decoder_.reset();
+
+        uint32_t size;
+        if (!Input_.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+            Done_ = true;
+            return;
+        }
+        Block_.resize(size);
+        if (!Input_.read(Block_.data(), size)) {
+            LOG_WARNING("Truncated block at the end of file (File: {})", File_);
+            Done_ = true;
+            return;
+        }
+        Decoder_.emplace(Block_);
+    }
+
+    std::filesystem::path File_;
+    std::ifstream Input_;
+    std::string Block_;
+    std::optional<TGorillaDecoder> Decoder_;
+    bool Done_ = false;
+
+    std::chrono::system_clock::time_point From_;
+    std::chrono::system_clock::time_point To_;
+};
+
+constexpr uint64_t LadderMagic = 0x3252444C41505354; // "TSPLADR2"
+
+// Fixed part of a summary, the sketch follows it.
+constexpr size_t SummarySize = 48;
+
+int64_t ToNanoseconds(std::chrono::system_clock::time_point timestamp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point FromNanoseconds(int64_t nanoseconds) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+}
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T Get(std::string_view& data) {
+    ASSERT(data.size() >= sizeof(T), "Ladder file is truncated");
+    T value;
+    std::memcpy(&value, data.data(), sizeof(T));
+    data.remove_prefix(sizeof(T));
+    return value;
+}
+
+void PutSummary(std::string& out, const TSummary& summary) {
+    Put<int64_t>(out, ToNanoseconds(summary.Start));
+    Put<uint64_t>(out, summary.Aggregate.Count);
+    Put<double>(out, summary.Aggregate.Sum);
+    Put<double>(out, summary.Aggregate.SumSquares);
+    Put<double>(out, summary.Aggregate.Min);
+    Put<double>(out, summary.Aggregate.Max);
+    summary.Sketch.Save(out);
+}
+
+TSummary GetSummary(std::string_view& data) {
+    TSummary summary;
+    summary.Start = FromNanoseconds(Get<int64_t>(data));
+    summary.Aggregate.Count = Get<uint64_t>(data);
+    summary.Aggregate.Sum = Get<double>(data);
+    summary.Aggregate.SumSquares = Get<double>(data);
+    summary.Aggregate.Min = Get<double>(data);
+    summary.Aggregate.Max = Get<double>(data);
+    summary.Sketch = TQuantileSketch::Load(data);
+    return summary;
+}
+
+// The ladder file holds every level with its open bucket and the timestamp
+// of the last reading, so a restart only replays newer raw readings.
+void WriteLadder(const std::filesystem::path& file, const TRollupLadder& ladder, bool sync) {
+    std::string data;
+    Put<uint64_t>(data, LadderMagic);
+    Put<double>(data, ladder.GetLevels().empty() ? 0 : ladder.GetLevels().front().GetAccuracy());
+    auto lastReading = ladder.GetLastReading();
+    Put<uint8_t>(data, lastReading.has_value());
+    Put<int64_t>(data, lastReading ? ToNanoseconds(*lastReading) : 0);
+    Put<uint32_t>(data, ladder.GetLevels().size());
+    for (const auto& level : ladder.GetLevels()) {
+        Put<int64_t>(data, std::chrono::duration_cast<std::chrono::nanoseconds>(level.GetResolution()).count());
+        Put<uint8_t>(data, level.GetOpen().has_value());
+        PutSummary(data, level.GetOpen().value_or(TSummary{}));
+        Put<uint64_t>(data, level.GetClosed().size());
+        for (const auto& summary : level.GetClosed()) {
+            PutSummary(data, summary);
+        }
+    }
+
+    auto tmpFile = file;
+    tmpFile += ".tmp";
+    try {
+        std::filesystem::create_directories(file.parent_path());
+        {
+            std::ofstream fout(tmpFile, std::ios::out | std::ios::trunc | std::ios::binary);
+            fout.write(data.data(), data.size());
+            ASSERT(fout.flush(), "Failed to write {}", tmpFile);
+        }
+        if (sync) {
+            NIpc::SyncFile(tmpFile);
+        }
+        std::filesystem::rename(tmpFile, file);
+    } catch (std::exception& ex) {
+        LOG_WARNING("Failed to write ladder (File: {}, Exception: {})", file, ex);
+    }
+}
+
+// Levels are matched by resolution. Levels missing from the file are built
+// from the next finer level, or from raw readings for the finest one.
+// Everything newer than the file is replayed afterwards.
+TRollupLadder ReadLadder(const NConfig::TLadderConfigPtr& config, const TReadingSequence& raw) {
+    std::vector<TLadderLevel> levels;
+    for (const auto& levelConfig : config->Levels) {
+        levels.emplace_back(levelConfig->Resolution, levelConfig->Retention, config->SketchAccuracy);
+    }
+    std::vector<bool> loaded(levels.size(), false);
+    std::optional<std::chrono::system_clock::time_point> lastReading;
+
+    try {
+        if (std::filesystem::exists(config->Path)) {
+            auto mapping = NCommon::New<NIpc::TMappedFile>(config->Path, 0, NIpc::EMappingMode::ReadOnly);
+            std::string_view data(static_cast<const char*>(mapping->GetData()), mapping->GetSize());
+
+            ASSERT(Get<uint64_t>(data) == LadderMagic, "Unknown ladder file format");
+            ASSERT(Get<double>(data) == config->SketchAccuracy, "Sketch accuracy has changed");
+            bool hasLastReading = Get<uint8_t>(data);
+            auto lastReadingNs = Get<int64_t>(data);
+            auto levelCount = Get<uint32_t>(data);
+
+            std::vector<std::pair<TSummarySequence, std::optional<TSummary>>> states(levels.size());
+            for (uint32_t i = 0; i < levelCount; i++) {
+                auto resolution = std::chrono::nanoseconds(Get<int64_t>(data));
+                bool hasOpen = Get<uint8_t>(data);
+                auto open = GetSummary(data);
+                auto closedCount = Get<uint64_t>(data);
+                ASSERT(closedCount <= data.size() / SummarySize, "Ladder file is truncated");
+
+                TSummarySequence closed;
+                for (uint64_t j = 0; j < closedCount; j++) {
+                    closed.push_back(GetSummary(data));
+                }
+
+                for (size_t index = 0; index < levels.size(); index++) {
+                    if (levels[index].GetResolution() == resolution) {
+                        states[index] = {std::move(closed), hasOpen ? std::optional(open) : std::nullopt};
+                        loaded[index] = true;
+                        break;
+                    }
+                }
+            }
+
+            for (size_t index = 0; index < levels.size(); index++) {
+                if (loaded[index]) {
+                    levels[index].SetState(std::move(states[index].first), std::move(states[index].second));
+                }
+            }
+            if (hasLastReading) {
+                lastReading = FromNanoseconds(lastReadingNs);
+            }
+        }
+    } catch (std::exception& ex) {
+        LOG_WARNING("Failed to read ladder, rebuilding it from raw readings (File: {}, Exception: {})", config->Path, ex);
+        levels.clear();
+        for (const auto& levelConfig : config->Levels) {
+            levels.emplace_back(levelConfig->Resolution, levelConfig->Retention, config->SketchAccuracy);
+        }
+        loaded.assign(levels.size(), false);
+        lastReading.reset();
+    }
+
+    if (lastReading) {
+        for (size_t index = 0; index < levels.size(); index++) {
+            if (loaded[index]) {
+                continue;
+            }
+            if (index > 0) {
+                levels[index].Rebuild(levels[index - 1]);
+            } else {
+                for (const auto& reading : raw) {
+                    if (reading.timestamp > *lastReading) {
+                        break;
+                    }
+                    levels[index].Add(reading, true);
+                }
+            }
+            // The next level was fed by another one so far.
+            if (index + 1 < levels.size() && loaded[index + 1]) {
+                levels[index + 1].ResetOpenSketch(levels[index]);
+            }
+        }
+    }
+
+    TRollupLadder ladder(std::move(levels));
+    ladder.SetLastReading(lastReading);
+    ladder.Restore(raw);
+    return ladder;
+}
+
+struct TApplyResult {
+    bool HourlyChanged = false;
+    bool DailyChanged = false;
+    bool LadderChanged = false;
+    bool Corrected = false;
+};
+
+// Folds a late reading into the closed average it belongs to. The bucket
+// ends at the entry and starts after the previous one. Its size is the count
+// kept for the entry or, for averages loaded from tier files, is counted in
+// the raw tier, so such buckets the raw tier does not fully cover stay as
+// they are. The reading must already be in the raw tier.
+bool CorrectAverage(TReadingSequence& tier, TBucketCountSequence& counts, const TReadingSequence& raw, const TReading& reading) {
+    auto it = std::lower_bound(tier.begin(), tier.end(), reading.timestamp, [] (const TReading& entry, auto timestamp) {
+        return entry.timestamp < timestamp;
+    });
+    if (it == tier.end() || it == tier.begin()) {
+        return false;
+    }
+
+    auto countIt = std::lower_bound(counts.begin(), counts.end(), it->timestamp, [] (const TBucketCount& entry, auto timestamp) {
+        return entry.Timestamp < timestamp;
+    });
+    if (countIt != counts.end() && countIt->Timestamp == it->timestamp) {
+        tier.replace(it, TReading(it->timestamp, TRollup::CorrectAverage(it->temperature, countIt->Count, reading.temperature)));
+        counts.replace(countIt, TBucketCount{countIt->Timestamp, countIt->Count + 1});
+        return true;
+    }
+
+    auto bucketStart = std::prev(it)->timestamp;
+    if (raw.empty() || raw.front().timestamp > bucketStart) {
+        return false;
+    }
+
+    // Readings with bucketStart < timestamp <= entry.
+    const auto tick = std::chrono::system_clock::duration(1);
+    auto count = TReadingRange::Slice(raw, bucketStart + tick, it->timestamp + tick).size();
+    if (count == 0) {
+        return false;
+    }
+
+    tier.replace(it, TReading(it->timestamp, TRollup::CorrectAverage(it->temperature, count - 1, reading.temperature)));
+    return true;
+}
+
+// Applies a reading older than the newest one in place: it is inserted
+// into the raw tier if still within retention, and the buckets it belongs
+// to are updated instead of being rebuilt.
+TApplyResult ApplyCorrection(TCache& cache, const TReading& reading) {
+    TApplyResult result{.Corrected = true};
+
+    auto& raw = cache.rawReadings;
+    if (reading.timestamp >= raw.back().timestamp - RawRetention) {
+        auto position = std::upper_bound(raw.begin(), raw.end(), reading.timestamp, [] (auto timestamp, const TReading& entry) {
+            return timestamp < entry.timestamp;
+        });
+        raw.insert(position, reading);
+    }
+
+    std::optional<std::chrono::system_clock::time_point> lastHourly;
+    std::optional<std::chrono::system_clock::time_point> lastDaily;
+    if (!cache.hourlyAverages.empty()) {
+        lastHourly = cache.hourlyAverages.back().timestamp;
+    }
+    if (!cache.dailyAverages.empty()) {
+        lastDaily = cache.dailyAverages.back().timestamp;
+    }
+    cache.rollup.Correct(reading, lastHourly, lastDaily);
+
+    result.HourlyChanged = CorrectAverage(cache.hourlyAverages, cache.hourlyCounts, raw, reading);
+    result.DailyChanged = CorrectAverage(cache.dailyAverages, cache.dailyCounts, raw, reading);
+    result.LadderChanged = cache.ladder.Correct(reading);
+    return result;
+}
+
+// Ingest step shared by ProcessTemperature and journal replay.
+TApplyResult ApplyReading(TCache& cache, const TReading& reading) {
+    if (!cache.rawReadings.empty() && reading.timestamp < cache.rawReadings.back().timestamp) {
+        return ApplyCorrection(cache, reading);
+    }
+
+    cache.rawReadings.push_back(reading);
+
+    const auto rawCutoff = reading.timestamp - RawRetention;
+    const auto hourlyCutoff = reading.timestamp - HourlyRetention;
+    const auto dailyCutoff = reading.timestamp - DailyRetention;
+
+    while (!cache.rawReadings.empty() && cache.rawReadings.front().timestamp < rawCutoff) {
+        cache.rawReadings.pop_front();
+    }
+
+    while (!cache.hourlyAverages.empty() && cache.hourlyAverages.front().timestamp < hourlyCutoff) {
+        cache.hourlyAverages.pop_front();
+    }
+
+    while (!cache.hourlyCounts.empty() && cache.hourlyCounts.front().Timestamp < hourlyCutoff) {
+        cache.hourlyCounts.pop_front();
+    }
+
+    while (!cache.dailyAverages.empty() && cache.dailyAverages.front().timestamp < dailyCutoff) {
+        cache.dailyAverages.pop_front();
+    }
+
+    while (!cache.dailyCounts.empty() && cache.dailyCounts.front().Timestamp < dailyCutoff) {
+        cache.dailyCounts.pop_front();
+    }
+
+    auto rollup = cache.rollup.Add(reading);
+
+    if (rollup.Hourly) {
+        cache.hourlyAverages.push_back(*rollup.Hourly);
+        cache.hourlyCounts.push_back(TBucketCount{rollup.Hourly->timestamp, rollup.HourlyCount});
+    }
+
+    if (rollup.Daily) {
+        cache.dailyAverages.push_back(*rollup.Daily);
+        cache.dailyCounts.push_back(TBucketCount{rollup.Daily->timestamp, rollup.DailyCount});
+    }
+
+    bool ladderChanged = cache.ladder.Add(reading);
+
+    return {rollup.Hourly.has_value(), rollup.Daily.has_value(), ladderChanged, false};
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 
-TFileStorage::TFileStorage(NConfig::TFileStorageConfigPtr config)
+TFileStorage::TFileStorage(NConfig::TFileStorageConfigPtr config, NCommon::TInvokerPtr invoker)
     : Config_(config)
 {
-    TCachePtr initialCache = NCommon::New<TCache>();
-    initialCache->rawReadings = ReadingsFromFile(Config_->TemperaturePath);
-    initialCache->hourlyAverages = ReadingsFromFile(Config_->TemperatureHourPath);
-    initialCache->dailyAverages = ReadingsFromFile(Config_->TemperatureDayPath);
+    if (Config_->RawFormat == NConfig::ERawStorageFormat::Segments) {
+        RawLog_ = std::make_unique<TSegmentLog>(Config_->TemperaturePath, Config_->SegmentDuration);
+    }
+
+    if (Config_->ReorderWindow.count() > 0) {
+        Reorder_.emplace(Config_->ReorderWindow);
+    }
+
+    TCachePtr initialCache;
+    if (Config_->JournalConfig) {
+        Journal_ = std::make_unique<TJournal>(Config_->JournalConfig);
+        // The journal has readings as they arrived. Replaying them through
+        // the reorder buffer applies them as ingest did and holds again the
+        // ones held when the service stopped.
+        std::vector<TReading> replayed;
+        initialCache = Journal_->Recover(
+            [&] { return LoadTiers(invoker); },
+            [&] (TCache& cache, const TReading& reading) {
+                if (!Reorder_ || !Reorder_->Push(reading)) {
+                    ApplyReading(cache, reading);
+                    return;
+                }
+                replayed.clear();
+                Reorder_->Pop(replayed);
+                for (const auto& ready : replayed) {
+                    ApplyReading(cache, ready);
+                }
+            },
+            [&] { return Reorder_ ? Reorder_->GetHeld() : std::vector<TReading>(); });
+    } else {
+        initialCache = LoadTiers(invoker);
+    }
+
+    if (Config_->LadderConfig) {
+        // The ladder file trails the raw tier by at most one finest bucket
+        // (or one checkpoint), raw readings must cover that gap.
+        ASSERT(Config_->LadderConfig->Levels.front()->Resolution <= RawRetention,
+            "Finest ladder resolution must not exceed the raw retention");
+        initialCache->ladder = ReadLadder(Config_->LadderConfig, initialCache->rawReadings);
+    }
+
+    if (Config_->SampleInterval && Config_->SampleInterval->count() > 0) {
+        // A day of readings at the expected rate. Expired chunks are then
+        // reused, a faster sensor just grows the sequence past the estimate.
+        initialCache->rawReadings.reserve(RawRetention / *Config_->SampleInterval);
+    }
+
     Cache_.Store(initialCache);
+
+    if (Config_->WriterConfig) {
+        TStorageWriter::TTickCallback tick;
+        if (Reorder_) {
+            tick = [this] { ReleaseHeld(); };
+        }
+        Writer_ = std::make_unique<TStorageWriter>(
+            Config_->WriterConfig,
+            [this] (const TStorageWriter::TBatch& batch, bool sync) { Commit(batch, sync); },
+            std::move(tick),
+            std::chrono::ceil<std::chrono::milliseconds>(Config_->ReorderWindow));
+    }
+}
+
+TFileStorage::~TFileStorage() {
+    std::lock_guard lock(WriteLock_);
+    if (Reorder_) {
+        Ready_.clear();
+        Reorder_->Flush(Ready_);
+        Ingest({}, Ready_);
+    }
 }
 
 void TFileStorage::ProcessTemperature(const TReading& reading) {
+    ProcessTemperatures({&reading, 1});
+}
+
+void TFileStorage::ProcessTemperatures(std::span<const TReading> readings) {
+    std::lock_guard lock(WriteLock_);
+
+    if (!Reorder_) {
+        Ingest(readings, readings);
+        return;
+    }
+
+    Ready_.clear();
+    for (const auto& reading : readings) {
+        if (!Reorder_->Push(reading)) {
+            // Late readings skip the buffer and go straight to the correction path.
+            Ready_.push_back(reading);
+            continue;
+        }
+        Reorder_->Pop(Ready_);
+    }
+    // All of them are journaled now, including the ones the buffer holds.
+    Ingest(readings, Ready_);
+}
+
+void TFileStorage::ReleaseHeld() {
+    std::lock_guard lock(WriteLock_);
+    Ready_.clear();
+    Reorder_->Expire(Ready_);
+    if (!Ready_.empty()) {
+        LOG_DEBUG("Releasing readings held for reordering (Count: {})", Ready_.size());
+        Ingest({}, Ready_);
+    }
+}
+
+void TFileStorage::Ingest(std::span<const TReading> arrived, std::span<const TReading> readings) {
+    // Until readings are released only the journal has something to write.
+    if (readings.empty() && (arrived.empty() || !Journal_)) {
+        return;
+    }
+
+    TStorageWriter::TBatch batch;
+    batch.Readings.assign(arrived.begin(), arrived.end());
+    batch.Applied.assign(readings.begin(), readings.end());
+    if (Journal_ && Reorder_) {
+        batch.Held = Reorder_->GetHeld();
+    }
+
+    if (readings.empty()) {
+        // Everything is held, only the journal gets the readings.
+        batch.Cache = Cache_.Acquire();
+        CommitOrEnqueue(std::move(batch));
+        return;
+    }
+
     TCachePtr currentCache = Cache_.Acquire();
     TCachePtr newCache = NCommon::New<TCache>();
     
-    // Copy the existing data
+    // Share the existing data, only the touched chunks get copied
     newCache->rawReadings = currentCache->rawReadings;
     newCache->hourlyAverages = currentCache->hourlyAverages;
     newCache->dailyAverages = currentCache->dailyAverages;
-    
-    newCache->rawReadings.push_back(reading);
-    
-    const auto hour_ago = reading.timestamp - std::chrono::hours(1);
-    const auto day_ago = reading.timestamp - std::chrono::days(1);
-    const auto month_ago = reading.timestamp - std::chrono::days(30);
-    const auto year_ago = reading.timestamp - std::chrono::days(360);
+    newCache->hourlyCounts = currentCache->hourlyCounts;
+    newCache->dailyCounts = currentCache->dailyCounts;
+    newCache->rollup = currentCache->rollup;
+    newCache->ladder = currentCache->ladder;
 
-    while (!newCache->rawReadings.empty() && newCache->rawReadings.front().timestamp < day_ago) {
-        newCache->rawReadings.pop_front();
-    }
-    
-    while (!newCache->hourlyAverages.empty() && newCache->hourlyAverages.front().timestamp < month_ago) {
-        newCache->hourlyAverages.pop_front();
+    TApplyResult changes;
+    for (const auto& reading : readings) {
+        auto applied = ApplyReading(*newCache, reading);
+        if (applied.Corrected) {
+            LOG_DEBUG("Late reading applied as correction (Reading: {})", ReadingToString(reading));
+        }
+        changes.HourlyChanged |= applied.HourlyChanged;
+        changes.DailyChanged |= applied.DailyChanged;
+        changes.LadderChanged |= applied.LadderChanged;
+        changes.Corrected |= applied.Corrected;
     }
 
-    while (!newCache->dailyAverages.empty() && newCache->dailyAverages.front().timestamp < year_ago) {
-        newCache->dailyAverages.pop_front();
+    Cache_.Store(newCache);
+
+    batch.Cache = std::move(newCache);
+    batch.HourlyChanged = changes.HourlyChanged;
+    batch.DailyChanged = changes.DailyChanged;
+    batch.LadderChanged = changes.LadderChanged;
+    batch.Corrected = changes.Corrected;
+    CommitOrEnqueue(std::move(batch));
+}
+
+void TFileStorage::CommitOrEnqueue(TStorageWriter::TBatch batch) {
+    if (Writer_) {
+        Writer_->Enqueue(std::move(batch));
+    } else {
+        Commit(batch, false);
     }
+}
 
-    ReadingsToFile(Config_->TemperaturePath, newCache->rawReadings);
+std::optional<TStorageWriter::TStatistics> TFileStorage::GetWriterStatistics() const {
+    if (!Writer_) {
+        return std::nullopt;
+    }
+    return Writer_->GetStatistics();
+}
 
-    // Create hourly average temperature
-    bool hourlyUpdate = newCache->hourlyAverages.empty() && newCache->rawReadings.front().timestamp < hour_ago
-        || !newCache->hourlyAverages.empty() && newCache->hourlyAverages.back().timestamp < hour_ago;
+TCachePtr TFileStorage::LoadTiers(const NCommon::TInvokerPtr& invoker) const {
+    auto loadRaw = [this] {
+        return RawLog_
+            ? TReadingSequence(RawLog_->ReadAll())
+            : ReadingsFromFile(Config_->TemperaturePath, Config_->FileFormat);
+    };
+    auto loadHourly = [this] {
+        return ReadingsFromFile(Config_->TemperatureHourPath, Config_->FileFormat);
+    };
+    auto loadDaily = [this] {
+        return ReadingsFromFile(Config_->TemperatureDayPath, Config_->FileFormat);
+    };
 
-    if (!hourlyUpdate) {
-        Cache_.Store(newCache);
-        return;
+    TCachePtr cache = NCommon::New<TCache>();
+    if (invoker) {
+        // The tiers are independent files, parse them side by side.
+        auto raw = invoker->Run(loadRaw);
+        auto hourly = invoker->Run(loadHourly);
+        auto daily = invoker->Run(loadDaily);
+        cache->rawReadings = raw.get().ValueOrThrow();
+        cache->hourlyAverages = hourly.get().ValueOrThrow();
+        cache->dailyAverages = daily.get().ValueOrThrow();
+    } else {
+        cache->rawReadings = loadRaw();
+        cache->hourlyAverages = loadHourly();
+        cache->dailyAverages = loadDaily();
     }
 
-    // Calculate hourly average
-    double sum = 0;
-    size_t count = 0;
-    for (auto iter = newCache->rawReadings.rbegin(); iter != newCache->rawReadings.rend() && iter->timestamp >= hour_ago; iter++) {
-        count++;
-        sum += iter->temperature;
+    cache->rollup.Restore(cache->rawReadings, cache->hourlyAverages, cache->dailyAverages);
+    return cache;
+}
+
+void TFileStorage::Commit(const TStorageWriter::TBatch& batch, bool sync) {
+    const auto& cache = *batch.Cache;
+
+    if (Journal_) {
+        for (const auto& reading : batch.Readings) {
+            Journal_->Append(reading);
+        }
+        Journal_->Flush(sync);
     }
-    newCache->hourlyAverages.emplace_back(reading.timestamp, sum / count);
 
-    ReadingsToFile(Config_->TemperatureHourPath, newCache->hourlyAverages);
-    
-    // Create daily average temperature
-    bool dailyUpdate = newCache->dailyAverages.empty() && newCache->hourlyAverages.front().timestamp < day_ago
-        || !newCache->dailyAverages.empty() && newCache->dailyAverages.back().timestamp < day_ago;
+    if (RawLog_ && !batch.Applied.empty()) {
+        // Late readings past the raw retention were not stored, they must
+        // not bring back expired segments either.
+        auto rawCutoff = cache.rawReadings.back().timestamp - RawRetention;
+        for (const auto& reading : batch.Applied) {
+            if (reading.timestamp >= rawCutoff) {
+                RawLog_->Append(reading);
+            }
+        }
+        RawLog_->Flush(sync);
+        RawLog_->DropBefore(batch.Applied.back().timestamp - RawRetention);
+    }
 
-    if (!dailyUpdate) {
-        Cache_.Store(newCache);
+    if (Journal_) {
+        // The journal is the source of truth, tier files are refreshed as
+        // exports on checkpoints only.
+        if (Journal_->IsCheckpointDue()) {
+            Journal_->Checkpoint(cache, batch.Held, sync);
+            if (!RawLog_) {
+                ReadingsToFile(Config_->TemperaturePath, cache.rawReadings, Config_->FileFormat, sync);
+            }
+            ReadingsToFile(Config_->TemperatureHourPath, cache.hourlyAverages, Config_->FileFormat, sync);
+            ReadingsToFile(Config_->TemperatureDayPath, cache.dailyAverages, Config_->FileFormat, sync);
+            if (Config_->LadderConfig) {
+                WriteLadder(Config_->LadderConfig->Path, cache.ladder, sync);
+            }
+        } else if (batch.Corrected && batch.LadderChanged && Config_->LadderConfig) {
+            // Replay catches the ladder up with newer readings only.
+            WriteLadder(Config_->LadderConfig->Path, cache.ladder, sync);
+        }
         return;
     }
 
-    // Calculate daily average
-    sum = 0;
-    count = 0;
-    for (auto iter = newCache->hourlyAverages.rbegin(); iter != newCache->hourlyAverages.rend() && iter->timestamp >= day_ago; iter++) {
-        count++;
-        sum += iter->temperature;
+    if (!RawLog_) {
+        ReadingsToFile(Config_->TemperaturePath, cache.rawReadings, Config_->FileFormat, sync);
     }
-    newCache->dailyAverages.emplace_back(reading.timestamp, sum / count);
 
-    ReadingsToFile(Config_->TemperatureDayPath, newCache->dailyAverages);
+    if (batch.HourlyChanged) {
+        ReadingsToFile(Config_->TemperatureHourPath, cache.hourlyAverages, Config_->FileFormat, sync);
+    }
 
-    Cache_.Store(newCache);
+    if (batch.DailyChanged) {
+        ReadingsToFile(Config_->TemperatureDayPath, cache.dailyAverages, Config_->FileFormat, sync);
+    }
+
+    if (batch.LadderChanged && Config_->LadderConfig) {
+        WriteLadder(Config_->LadderConfig->Path, cache.ladder, sync);
+    }
 }
 
-const std::deque<TReading>& TFileStorage::GetRawReadings() {
-    return Cache_.Acquire()->rawReadings;
+TReadingCursorPtr TFileStorage::OpenFileCursor(
+    const NConfig::TFileStorageConfig& config,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    std::filesystem::path file;
+    switch (tier) {
+        case ETier::Hourly:
+            file = config.TemperatureHourPath;
+            break;
+        case ETier::Daily:
+            file = config.TemperatureDayPath;
+            break;
+        case ETier::Raw:
+        default:
+            if (config.RawFormat == NConfig::ERawStorageFormat::Segments) {
+                return TSegmentLog::OpenCursor(config.TemperaturePath, config.SegmentDuration, from, to);
+            }
+            file = config.TemperaturePath;
+            break;
+    }
+
+    if (config.FileFormat == NConfig::ETierFileFormat::Gorilla) {
+        return std::make_unique<TGorillaFileCursor>(file, from, to);
+    }
+    return std::make_unique<TTextFileCursor>(file, from, to);
 }
 
-const std::deque<TReading>& TFileStorage::GetHourlyAverage() {
-    return Cache_.Acquire()->hourlyAverages;
+TStorageSnapshot TFileStorage::GetSnapshot() {
+    return TStorageSnapshot(Cache_.Acquire());
 }
 
-const std::deque<TReading>& TFileStorage::GetDailyAverage() {
-    return Cache_.Acquire()->dailyAverages;
+TReadingRange TFileStorage::GetRange(
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    return TReadingRange::Slice(Cache_.Acquire()->GetTier(tier), from, to);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2,7 +2,18 @@
 
 #include <service/storage.h>
 #include <service/config.h>
+#include <service/cursor.h>
+#include <service/journal.h>
+#include <service/reorder_buffer.h>
+#include <service/segment_log.h>
+#include <service/storage_writer.h>
 #include <common/atomic_intrusive_ptr.h>
+#include <common/threadpool.h>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace NService {
 
@@ -12,17 +23,74 @@ class TFileStorage
     : public TTemperatureStorage
 {
 public:
-    TFileStorage(NConfig::TFileStorageConfigPtr config);
+    // Tier files are loaded in parallel on the invoker when it is given.
+    TFileStorage(NConfig::TFileStorageConfigPtr config, NCommon::TInvokerPtr invoker = NCommon::TInvokerPtr());
+
+    // Readings still held for reordering are applied.
+    ~TFileStorage();
+
+    TStorageSnapshot GetSnapshot() override;
 
-    const std::deque<TReading>& GetRawReadings() override;
-    const std::deque<TReading>& GetHourlyAverage() override;
-    const std::deque<TReading>& GetDailyAverage() override;
+    TReadingRange GetRange(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) override;
 
     void ProcessTemperature(const TReading& reading) override;
 
+    // The batch is applied to one new cache version and committed at once.
+    void ProcessTemperatures(std::span<const TReading> readings) override;
+
+    // Streams a tier straight from the files of a storage with this config
+    // without loading it, for tools scanning histories larger than memory.
+    // With a journal the tier files lag behind by up to one checkpoint.
+    static TReadingCursorPtr OpenFileCursor(
+        const NConfig::TFileStorageConfig& config,
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+    // Set only when a background writer is configured.
+    std::optional<TStorageWriter::TStatistics> GetWriterStatistics() const;
+
+private:
+    TCachePtr LoadTiers(const NCommon::TInvokerPtr& invoker) const;
+
+    // Publishes a cache with the readings applied and hands it to the writer.
+    // Arrived readings are journaled, they include the ones held for
+    // reordering and may lack the released ones.
+    void Ingest(std::span<const TReading> arrived, std::span<const TReading> readings);
+
+    void CommitOrEnqueue(TStorageWriter::TBatch batch);
+
+    // Applies the readings held for reordering once nothing has arrived for
+    // the reorder window, runs on the writer tick.
+    void ReleaseHeld();
+
+    // Persists the batch, runs on the writer thread if there is one.
+    void Commit(const TStorageWriter::TBatch& batch, bool sync);
+
 public:
     NConfig::TFileStorageConfigPtr Config_;
     NCommon::TAtomicIntrusivePtr<TCache> Cache_;
+
+    // Cache versions share chunks, so updates must not interleave.
+    std::mutex WriteLock_;
+
+    // Set only when the reorder window is configured, guarded by WriteLock_.
+    std::optional<TReorderBuffer> Reorder_;
+
+    // Readings due for ingest, reused between batches.
+    std::vector<TReading> Ready_;
+
+    // Set only when raw readings are stored as binary segments.
+    std::unique_ptr<TSegmentLog> RawLog_;
+
+    // Set only when the journal is configured.
+    std::unique_ptr<TJournal> Journal_;
+
+    // Declared last so that pending commits are done before the rest goes.
+    std::unique_ptr<TStorageWriter> Writer_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,421 @@
+#include <service/journal.h>
+#include <service/compression.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+#include <ipc/file_sync.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "Journal";
+
+constexpr std::string_view LogExtension = ".wal";
+constexpr std::string_view CheckpointName = "checkpoint";
+constexpr std::string_view PreviousCheckpointName = "checkpoint.prev";
+constexpr uint64_t CheckpointMagicV1 = 0x3154504B43505354; // "TSPCKPT1", without bucket counts
+constexpr uint64_t CheckpointMagic = 0x3254504B43505354; // "TSPCKPT2"
+
+// Checkpoints keep timestamps exact.
+constexpr auto CheckpointResolution = std::chrono::nanoseconds(1);
+
+uint64_t Fnv1a(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+int64_t ToNanoseconds(std::chrono::system_clock::time_point timestamp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point FromNanoseconds(int64_t nanoseconds) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+}
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Bounds-checked reader over a checkpoint image.
+class TCheckpointReader {
+public:
+    explicit TCheckpointReader(std::string_view data)
+        : Data_(data)
+    { }
+
+    template <typename T>
+    T Get() {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view Take(size_t size) {
+        ASSERT(Offset_ + size <= Data_.size(), "Checkpoint is truncated");
+        auto result = Data_.substr(Offset_, size);
+        Offset_ += size;
+        return result;
+    }
+
+private:
+    std::string_view Data_;
+    size_t Offset_ = 0;
+};
+
+void PutBucket(std::string& out, const TRollup::TBucket& bucket) {
+    Put<uint8_t>(out, bucket.Start.has_value());
+    Put<int64_t>(out, bucket.Start ? ToNanoseconds(*bucket.Start) : 0);
+    Put<uint64_t>(out, bucket.Aggregate.Count);
+    Put<double>(out, bucket.Aggregate.Sum);
+    Put<double>(out, bucket.Aggregate.Min);
+    Put<double>(out, bucket.Aggregate.Max);
+}
+
+TRollup::TBucket GetBucket(TCheckpointReader& reader) {
+    TRollup::TBucket bucket;
+    bool hasStart = reader.Get<uint8_t>();
+    auto start = reader.Get<int64_t>();
+    if (hasStart) {
+        bucket.Start = FromNanoseconds(start);
+    }
+    bucket.Aggregate.Count = reader.Get<uint64_t>();
+    bucket.Aggregate.Sum = reader.Get<double>();
+    bucket.Aggregate.Min = reader.Get<double>();
+    bucket.Aggregate.Max = reader.Get<double>();
+    return bucket;
+}
+
+void PutTier(std::string& out, const TReadingSequence& readings) {
+    auto blocks = EncodeGorillaBlocks(readings, 1024, CheckpointResolution);
+    Put<uint32_t>(out, blocks.size());
+    for (const auto& block : blocks) {
+        Put<uint32_t>(out, block.size());
+        out.append(block);
+    }
+}
+
+TReadingSequence GetTier(TCheckpointReader& reader) {
+    TReadingSequence readings;
+    auto blockCount = reader.Get<uint32_t>();
+    for (uint32_t i = 0; i < blockCount; i++) {
+        auto size = reader.Get<uint32_t>();
+        TGorillaDecoder decoder(reader.Take(size));
+        TReading reading;
+        while (decoder.Next(reading)) {
+            readings.push_back(reading);
+        }
+    }
+    return readings;
+}
+
+void PutCounts(std::string& out, const TBucketCountSequence& counts) {
+    Put<uint32_t>(out, counts.size());
+    for (const auto& count : counts) {
+        Put<int64_t>(out, ToNanoseconds(count.Timestamp));
+        Put<uint64_t>(out, count.Count);
+    }
+}
+
+TBucketCountSequence GetCounts(TCheckpointReader& reader) {
+    TBucketCountSequence counts;
+    auto size = reader.Get<uint32_t>();
+    for (uint32_t i = 0; i < size; i++) {
+        auto timestamp = FromNanoseconds(reader.Get<int64_t>());
+        counts.push_back(TBucketCount{timestamp, reader.Get<uint64_t>()});
+    }
+    return counts;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TJournal::TJournal(NConfig::TJournalConfigPtr config)
+    : Config_(std::move(config)),
+      LastCheckpoint_(std::chrono::steady_clock::now())
+{
+    std::filesystem::create_directories(Config_->Path);
+
+    for (const auto& entry : std::filesystem::directory_iterator(Config_->Path)) {
+        if (!entry.is_regular_file() || entry.path().extension() != LogExtension) {
+            continue;
+        }
+
+        auto stem = entry.path().stem().string();
+        uint64_t sequence;
+        auto [ptr, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), sequence);
+        if (ec != std::errc() || ptr != stem.data() + stem.size()) {
+            LOG_WARNING("Skipping unknown file in journal directory (File: {})", entry.path());
+            continue;
+        }
+        Logs_.push_back(sequence);
+    }
+
+    std::sort(Logs_.begin(), Logs_.end());
+}
+
+TCachePtr TJournal::Recover(const TLoadCallback& load, const TApplyCallback& apply, const TPendingCallback& pending) {
+    uint64_t logSequence = 0;
+    auto cache = ReadCheckpoint(GetCheckpointPath(), logSequence);
+    if (!cache) {
+        cache = ReadCheckpoint(GetPreviousCheckpointPath(), logSequence);
+        if (cache) {
+            LOG_WARNING("Recovering from the previous checkpoint (File: {})", GetPreviousCheckpointPath());
+        }
+    }
+    bool hasCheckpoint = static_cast<bool>(cache);
+
+    // Checkpoints delete the logs they cover, so replaying onto an empty
+    // cache would lose that history. The tier files exported with the last
+    // checkpoint hold it instead; late readings in the logs that fall before
+    // their newest raw reading cannot be told from stored ones and are lost.
+    std::optional<std::chrono::system_clock::time_point> replayAfter;
+    if (!hasCheckpoint) {
+        cache = load();
+        if (!cache->rawReadings.empty()) {
+            replayAfter = cache->rawReadings.back().timestamp;
+        }
+    }
+
+    size_t replayed = 0;
+    for (auto sequence : Logs_) {
+        if (sequence >= logSequence) {
+            replayed += ReplayLog(sequence, *cache, apply, replayAfter);
+        }
+    }
+
+    OpenLog(Logs_.empty() ? logSequence : std::max(Logs_.back() + 1, logSequence));
+    RetainedSequence_ = logSequence;
+    RecordsSinceCheckpoint_ = replayed;
+
+    LOG_INFO("Journal recovered (Checkpoint: {}, Replayed records: {})", hasCheckpoint, replayed);
+
+    if (!hasCheckpoint) {
+        Checkpoint(*cache, pending ? pending() : std::vector<TReading>(), true);
+    }
+    return cache;
+}
+
+void TJournal::Append(const TReading& reading) {
+    TRecord record{ToNanoseconds(reading.timestamp), reading.temperature, 0};
+    record.Checksum = Fnv1a(&record, offsetof(TRecord, Checksum));
+
+    Current_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    if (!Current_) {
+        LOG_WARNING("Failed to append reading to journal (File: {})", GetLogPath(CurrentSequence_));
+        Current_.clear();
+    }
+    RecordsSinceCheckpoint_++;
+}
+
+void TJournal::Flush(bool sync) {
+    Current_.flush();
+    if (!Current_) {
+        LOG_WARNING("Failed to flush journal (File: {})", GetLogPath(CurrentSequence_));
+        Current_.clear();
+        return;
+    }
+
+    if (sync) {
+        NIpc::SyncFile(GetLogPath(CurrentSequence_));
+    }
+}
+
+bool TJournal::IsCheckpointDue() const {
+    if (RecordsSinceCheckpoint_ >= Config_->CheckpointRecords) {
+        return true;
+    }
+    return RecordsSinceCheckpoint_ > 0
+        && std::chrono::steady_clock::now() - LastCheckpoint_ >= Config_->CheckpointInterval;
+}
+
+void TJournal::Checkpoint(const TCache& cache, std::span<const TReading> pending, bool sync) {
+    Flush(sync);
+
+    // Records appended from now on go after the checkpoint.
+    auto logSequence = CurrentSequence_ + 1;
+    OpenLog(logSequence);
+    for (const auto& reading : pending) {
+        Append(reading);
+    }
+    Flush(sync);
+
+    try {
+        WriteCheckpoint(cache, logSequence, sync);
+    } catch (const std::exception& ex) {
+        LOG_ERROR("Failed to write checkpoint, keeping the log (Exception: {})", ex);
+        // The old checkpoint replays the pending readings from older logs.
+        OpenLog(logSequence);
+        return;
+    }
+
+    // Logs of the checkpoint that has just become the previous one stay.
+    while (!Logs_.empty() && Logs_.front() < RetainedSequence_) {
+        std::error_code ec;
+        std::filesystem::remove(GetLogPath(Logs_.front()), ec);
+        if (ec) {
+            LOG_WARNING("Failed to remove journal file (File: {}, Error: {})", GetLogPath(Logs_.front()), ec.message());
+        }
+        Logs_.pop_front();
+    }
+
+    RetainedSequence_ = logSequence;
+    RecordsSinceCheckpoint_ = pending.size();
+    LastCheckpoint_ = std::chrono::steady_clock::now();
+}
+
+std::filesystem::path TJournal::GetLogPath(uint64_t sequence) const {
+    return Config_->Path / (std::to_string(sequence) + std::string(LogExtension));
+}
+
+std::filesystem::path TJournal::GetCheckpointPath() const {
+    return Config_->Path / CheckpointName;
+}
+
+std::filesystem::path TJournal::GetPreviousCheckpointPath() const {
+    return Config_->Path / PreviousCheckpointName;
+}
+
+void TJournal::OpenLog(uint64_t sequence) {
+    Current_.close();
+    Current_.clear();
+
+    // Never append after a torn record of an older run.
+    auto path = GetLogPath(sequence);
+    Current_.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!Current_.is_open()) {
+        LOG_WARNING("Failed to open journal file (File: {})", path);
+    }
+    CurrentSequence_ = sequence;
+
+    if (Logs_.empty() || Logs_.back() < sequence) {
+        Logs_.push_back(sequence);
+    }
+}
+
+size_t TJournal::ReplayLog(
+    uint64_t sequence,
+    TCache& cache,
+    const TApplyCallback& apply,
+    std::optional<std::chrono::system_clock::time_point> after) const
+{
+    auto path = GetLogPath(sequence);
+    size_t replayed = 0;
+    try {
+        std::ifstream fin(path, std::ios::in | std::ios::binary);
+        TRecord record;
+        while (fin.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            if (record.Checksum != Fnv1a(&record, offsetof(TRecord, Checksum))) {
+                LOG_WARNING("Journal record is damaged, skipping rest of file (File: {}, Record: {})", path, replayed);
+                break;
+            }
+            auto timestamp = FromNanoseconds(record.Timestamp);
+            // Text tier files keep whole seconds, so the newest stored
+            // reading matches every record within its second.
+            if (after && (timestamp <= *after || std::chrono::floor<std::chrono::seconds>(timestamp) == *after)) {
+                continue;
+            }
+            apply(cache, {timestamp, record.Temperature});
+            replayed++;
+        }
+    } catch (std::exception& ex) {
+        LOG_WARNING("Failed to replay journal file (File: {}, Exception: {})", path, ex);
+    }
+    return replayed;
+}
+
+TCachePtr TJournal::ReadCheckpoint(const std::filesystem::path& path, uint64_t& logSequence) const {
+    if (!std::filesystem::exists(path)) {
+        return TCachePtr();
+    }
+
+    try {
+        std::ifstream fin(path, std::ios::in | std::ios::binary);
+        std::string data(std::filesystem::file_size(path), '\0');
+        ASSERT(fin.read(data.data(), data.size()), "Failed to read checkpoint");
+        ASSERT(data.size() >= 2 * sizeof(uint64_t), "Checkpoint is truncated");
+
+        uint64_t checksum;
+        std::memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+        ASSERT(checksum == Fnv1a(data.data(), data.size() - sizeof(checksum)), "Checkpoint checksum mismatch");
+
+        TCheckpointReader reader(data);
+        auto magic = reader.Get<uint64_t>();
+        ASSERT(magic == CheckpointMagic || magic == CheckpointMagicV1, "Unknown checkpoint format");
+        logSequence = reader.Get<uint64_t>();
+
+        auto cache = NCommon::New<TCache>();
+        auto hourly = GetBucket(reader);
+        auto daily = GetBucket(reader);
+        cache->rollup.SetState(hourly, daily);
+        cache->rawReadings = GetTier(reader);
+        cache->hourlyAverages = GetTier(reader);
+        cache->dailyAverages = GetTier(reader);
+        if (magic != CheckpointMagicV1) {
+            cache->hourlyCounts = GetCounts(reader);
+            cache->dailyCounts = GetCounts(reader);
+        }
+
+        LOG_INFO("Checkpoint loaded (File: {}, Size: {} bytes)", path, data.size());
+        return cache;
+    } catch (std::exception& ex) {
+        LOG_ERROR("Failed to load checkpoint (File: {}, Exception: {})", path, ex);
+        logSequence = 0;
+        return TCachePtr();
+    }
+}
+
+void TJournal::WriteCheckpoint(const TCache& cache, uint64_t logSequence, bool sync) const {
+    std::string data;
+    Put<uint64_t>(data, CheckpointMagic);
+    Put<uint64_t>(data, logSequence);
+    PutBucket(data, cache.rollup.GetHourlyState());
+    PutBucket(data, cache.rollup.GetDailyState());
+    PutTier(data, cache.rawReadings);
+    PutTier(data, cache.hourlyAverages);
+    PutTier(data, cache.dailyAverages);
+    PutCounts(data, cache.hourlyCounts);
+    PutCounts(data, cache.dailyCounts);
+    Put<uint64_t>(data, Fnv1a(data.data(), data.size()));
+
+    auto path = GetCheckpointPath();
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+
+    {
+        std::ofstream fout(tmpPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        fout.write(data.data(), data.size());
+        fout.flush();
+        ASSERT(fout, "Failed to write {}", tmpPath);
+    }
+    if (sync) {
+        NIpc::SyncFile(tmpPath);
+    }
+    if (std::filesystem::exists(path)) {
+        std::filesystem::rename(path, GetPreviousCheckpointPath());
+    }
+    std::filesystem::rename(tmpPath, path);
+
+    LOG_DEBUG("Checkpoint written (File: {}, Size: {} bytes, Log: {})", path, data.size(), logSequence);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
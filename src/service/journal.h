@@ -0,0 +1,104 @@
+#pragma once
+
+#include <service/config.h>
+#include <service/storage.h>
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Write-ahead log of raw readings plus a checkpoint of the whole cache.
+//
+// Readings are appended to <path>/<sequence>.wal as checksummed records.
+// A checkpoint starts a new log file and then atomically replaces
+// <path>/checkpoint with the tiers (gorilla blocks), the open rollup
+// buckets and the counts of the closed ones. The checkpoint it replaces is kept as <path>/checkpoint.prev,
+// log files older than that one are deleted afterwards.
+// Recovery loads the newest readable checkpoint and replays only the log
+// files after it.
+class TJournal {
+public:
+    // Applies a replayed reading to the cache the same way ingest does.
+    using TApplyCallback = std::function<void(TCache& cache, const TReading& reading)>;
+
+    // Builds the cache from the tier files.
+    using TLoadCallback = std::function<TCachePtr()>;
+
+    // Replayed readings that apply has not put into the cache yet.
+    using TPendingCallback = std::function<std::vector<TReading>()>;
+
+    explicit TJournal(NConfig::TJournalConfigPtr config);
+
+    // If neither checkpoint is readable, the cache comes from load, only log
+    // records newer than its raw readings are replayed and a checkpoint is
+    // written right away.
+    TCachePtr Recover(
+        const TLoadCallback& load,
+        const TApplyCallback& apply,
+        const TPendingCallback& pending = TPendingCallback());
+
+    // Buffered, call Flush to push appended readings to the file.
+    void Append(const TReading& reading);
+
+    // Waits for the data to reach the disk when sync is set.
+    void Flush(bool sync);
+
+    bool IsCheckpointDue() const;
+
+    // The cache must contain every reading appended so far except pending
+    // ones, e.g. held for reordering. Those are appended again after the
+    // checkpoint, so that replay finds them.
+    void Checkpoint(const TCache& cache, std::span<const TReading> pending, bool sync);
+
+private:
+    struct TRecord {
+        int64_t Timestamp;
+        double Temperature;
+        uint64_t Checksum;
+    };
+
+    static_assert(sizeof(TRecord) == 24);
+
+    std::filesystem::path GetLogPath(uint64_t sequence) const;
+    std::filesystem::path GetCheckpointPath() const;
+    std::filesystem::path GetPreviousCheckpointPath() const;
+
+    void OpenLog(uint64_t sequence);
+
+    // Records at or before after are skipped.
+    size_t ReplayLog(
+        uint64_t sequence,
+        TCache& cache,
+        const TApplyCallback& apply,
+        std::optional<std::chrono::system_clock::time_point> after) const;
+
+    TCachePtr ReadCheckpoint(const std::filesystem::path& path, uint64_t& logSequence) const;
+    void WriteCheckpoint(const TCache& cache, uint64_t logSequence, bool sync) const;
+
+    NConfig::TJournalConfigPtr Config_;
+
+    std::deque<uint64_t> Logs_;
+    std::ofstream Current_;
+    uint64_t CurrentSequence_ = 0;
+
+    // First log of the newest checkpoint. The logs from it on are kept until
+    // the next checkpoint is written, so that the previous checkpoint can be
+    // replayed if the newest one is damaged.
+    uint64_t RetainedSequence_ = 0;
+
+    size_t RecordsSinceCheckpoint_ = 0;
+    std::chrono::steady_clock::time_point LastCheckpoint_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <common/persistent_sequence.h>
+
+#include <ipc/mapped_file.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct TReading {
+    std::chrono::system_clock::time_point timestamp;
+    double temperature;
+};
+
+// Zone map of a storage block: value scans skip blocks it rules out.
+struct TReadingZone {
+    double Min = 0;
+    double Max = 0;
+    size_t Count = 0;
+
+    void Add(const TReading& reading) {
+        if (Count == 0) {
+            Min = Max = reading.temperature;
+        } else {
+            Min = std::min(Min, reading.temperature);
+            Max = std::max(Max, reading.temperature);
+        }
+        Count++;
+    }
+
+    bool Overlaps(double low, double high) const {
+        return Count > 0 && Min <= high && Max >= low;
+    }
+};
+
+// Copies share storage, so publishing a new cache per reading is cheap.
+// Blocks of 512 readings carry a zone map.
+using TReadingSequence = NCommon::TPersistentSequence<TReading, 512, TReadingZone>;
+
+enum class ETier {
+    Raw,
+    Hourly,
+    Daily
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Contiguous slice of a reading sequence or of mapped timestamp (int64
+// nanoseconds) and value columns. The slice owns a copy of the sequence,
+// which shares chunks with the source, or holds the mappings, so it stays
+// valid after the source moves on. Readings are returned by value since the
+// columns have no TReading to refer to.
+class TReadingRange {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = TReading;
+        using difference_type = ptrdiff_t;
+        using reference = TReading;
+
+        struct pointer {
+            TReading Reading;
+            const TReading* operator->() const { return &Reading; }
+        };
+
+        const_iterator() = default;
+
+        const_iterator(const TReadingRange* range, size_t index)
+            : Range_(range), Index_(index)
+        { }
+
+        reference operator*() const { return (*Range_)[Index_]; }
+        pointer operator->() const { return {(*Range_)[Index_]}; }
+        reference operator[](difference_type n) const { return (*Range_)[Index_ + n]; }
+
+        const_iterator& operator++() { ++Index_; return *this; }
+        const_iterator operator++(int) { auto copy = *this; ++Index_; return copy; }
+        const_iterator& operator--() { --Index_; return *this; }
+        const_iterator operator--(int) { auto copy = *this; --Index_; return copy; }
+
+        const_iterator& operator+=(difference_type n) { Index_ += n; return *this; }
+        const_iterator& operator-=(difference_type n) { Index_ -= n; return *this; }
+
+        friend const_iterator operator+(const_iterator it, difference_type n) { return it += n; }
+        friend const_iterator operator+(difference_type n, const_iterator it) { return it += n; }
+        friend const_iterator operator-(const_iterator it, difference_type n) { return it -= n; }
+
+        friend difference_type operator-(const const_iterator& lhs, const const_iterator& rhs) {
+            return static_cast<difference_type>(lhs.Index_) - static_cast<difference_type>(rhs.Index_);
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs.Index_ == rhs.Index_; }
+        friend auto operator<=>(const const_iterator& lhs, const const_iterator& rhs) { return lhs.Index_ <=> rhs.Index_; }
+
+        size_t Index() const { return Index_; }
+
+    private:
+        const TReadingRange* Range_ = nullptr;
+        size_t Index_ = 0;
+    };
+
+    TReadingRange() = default;
+
+    TReadingRange(TReadingSequence sequence, size_t begin, size_t end)
+        : Sequence_(std::move(sequence)), Begin_(begin), End_(end)
+    { }
+
+    // Records [begin, end) of the columns, which must not be written again
+    // while the range lives.
+    TReadingRange(
+        NIpc::TMappedFilePtr timestampsFile,
+        NIpc::TMappedFilePtr valuesFile,
+        const int64_t* timestamps,
+        const double* values,
+        size_t begin,
+        size_t end)
+        : TimestampsFile_(std::move(timestampsFile)),
+          ValuesFile_(std::move(valuesFile)),
+          Timestamps_(timestamps),
+          Values_(values),
+          Begin_(begin),
+          End_(end)
+    { }
+
+    // Readings with from <= timestamp < to, found by binary search.
+    static TReadingRange Slice(
+        const TReadingSequence& sequence,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to)
+    {
+        return TReadingRange(sequence, 0, sequence.size()).Slice(from, to);
+    }
+
+    TReadingRange Slice(
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const
+    {
+        auto first = std::lower_bound(begin(), end(), from, [] (const TReading& reading, auto timestamp) {
+            return reading.timestamp < timestamp;
+        });
+        auto last = std::max(first, std::lower_bound(first, end(), to, [] (const TReading& reading, auto timestamp) {
+            return reading.timestamp < timestamp;
+        }));
+
+        auto slice = *this;
+        slice.Begin_ = Begin_ + first.Index();
+        slice.End_ = Begin_ + last.Index();
+        return slice;
+    }
+
+    size_t size() const { return End_ - Begin_; }
+    bool empty() const { return End_ == Begin_; }
+
+    TReading operator[](size_t index) const {
+        size_t position = Begin_ + index;
+        if (Timestamps_) {
+            auto since = std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds(Timestamps_[position]));
+            return {std::chrono::system_clock::time_point(since), Values_[position]};
+        }
+        return Sequence_[position];
+    }
+
+    TReading front() const { return (*this)[0]; }
+    TReading back() const { return (*this)[size() - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    // Calls onReading for the readings with low <= temperature <= high,
+    // oldest first. Whole blocks the zone maps rule out are not read, so a
+    // rare excursion is found in far fewer steps than there are readings.
+    // Columns have no zone maps and are scanned through.
+    template <typename TOnReading>
+    void ScanValues(double low, double high, const TOnReading& onReading) const {
+        if (Timestamps_) {
+            for (size_t index = 0; index < size(); index++) {
+                double value = Values_[Begin_ + index];
+                if (value >= low && value <= high) {
+                    onReading((*this)[index]);
+                }
+            }
+            return;
+        }
+
+        size_t index = Begin_;
+        while (index < End_) {
+            size_t blockEnd = std::min(Sequence_.GetChunkEnd(index), End_);
+            const auto* zone = Sequence_.GetChunkSummary(index);
+            if (!zone || zone->Overlaps(low, high)) {
+                for (; index < blockEnd; index++) {
+                    const auto& reading = Sequence_[index];
+                    if (reading.temperature >= low && reading.temperature <= high) {
+                        onReading(reading);
+                    }
+                }
+            }
+            index = blockEnd;
+        }
+    }
+
+private:
+    TReadingSequence Sequence_;
+
+    NIpc::TMappedFilePtr TimestampsFile_;
+    NIpc::TMappedFilePtr ValuesFile_;
+    const int64_t* Timestamps_ = nullptr;
+    const double* Values_ = nullptr;
+
+    size_t Begin_ = 0;
+    size_t End_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
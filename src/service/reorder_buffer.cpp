@@ -0,0 +1,65 @@
+#include <service/reorder_buffer.h>
+
+#include <common/exception.h>
+
+#include <algorithm>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+TReorderBuffer::TReorderBuffer(TDuration window)
+    : Window_(window)
+{
+    ASSERT(Window_ >= TDuration::zero(), "Reorder window must not be negative");
+}
+
+bool TReorderBuffer::Push(const TReading& reading) {
+    if (Released_ && reading.timestamp < *Released_) {
+        return false;
+    }
+
+    Held_.push_back(reading);
+    std::push_heap(Held_.begin(), Held_.end(), TNewer());
+    if (!Newest_ || reading.timestamp > *Newest_) {
+        Newest_ = reading.timestamp;
+    }
+    LastPush_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+void TReorderBuffer::Pop(std::vector<TReading>& ready) {
+    while (!Held_.empty() && Held_.front().timestamp <= *Newest_ - Window_) {
+        Released_ = Held_.front().timestamp;
+        ready.push_back(Held_.front());
+        std::pop_heap(Held_.begin(), Held_.end(), TNewer());
+        Held_.pop_back();
+    }
+}
+
+void TReorderBuffer::Flush(std::vector<TReading>& ready) {
+    while (!Held_.empty()) {
+        Released_ = Held_.front().timestamp;
+        ready.push_back(Held_.front());
+        std::pop_heap(Held_.begin(), Held_.end(), TNewer());
+        Held_.pop_back();
+    }
+}
+
+void TReorderBuffer::Expire(std::vector<TReading>& ready) {
+    if (!Held_.empty() && std::chrono::steady_clock::now() - LastPush_ >= Window_) {
+        Flush(ready);
+    }
+}
+
+std::vector<TReading> TReorderBuffer::GetHeld() const {
+    return Held_;
+}
+
+size_t TReorderBuffer::GetSize() const {
+    return Held_.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
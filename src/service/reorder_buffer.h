@@ -0,0 +1,60 @@
+#pragma once
+
+#include <service/reading.h>
+
+#include <chrono>
+#include <optional>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Holds readings for a short window and releases them in timestamp order.
+// A reading is released once one at least the window newer has arrived, so
+// readings delayed by less than the window are put back in place. Readings
+// older than one already released are late, the buffer refuses them.
+// Once nothing has been pushed for a window, Expire releases the rest, so
+// the last readings of a quiet sensor are not held until the next one.
+class TReorderBuffer {
+public:
+    using TDuration = std::chrono::system_clock::duration;
+
+    explicit TReorderBuffer(TDuration window);
+
+    // Returns false for a late reading, it is not buffered then.
+    bool Push(const TReading& reading);
+
+    // Appends the readings that are due to ready, oldest first.
+    void Pop(std::vector<TReading>& ready);
+
+    // Appends everything held to ready, oldest first.
+    void Flush(std::vector<TReading>& ready);
+
+    // Flushes if the last push was at least a window ago.
+    void Expire(std::vector<TReading>& ready);
+
+    // Readings held, in no particular order.
+    std::vector<TReading> GetHeld() const;
+
+    size_t GetSize() const;
+
+private:
+    struct TNewer {
+        bool operator()(const TReading& lhs, const TReading& rhs) const {
+            return lhs.timestamp > rhs.timestamp;
+        }
+    };
+
+    TDuration Window_;
+
+    // Heap with the oldest reading on top.
+    std::vector<TReading> Held_;
+    std::optional<std::chrono::system_clock::time_point> Newest_;
+    std::optional<std::chrono::system_clock::time_point> Released_;
+    std::chrono::steady_clock::time_point LastPush_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,294 @@
+#include <service/segment_log.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+#include <ipc/file_sync.h>
+
+#include <algorithm>
+#include <charconv>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "SegmentLog";
+
+constexpr std::string_view SegmentExtension = ".seg";
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+class TSegmentLog::TCursor
+    : public TReadingCursor
+{
+public:
+    TCursor(
+        std::vector<std::filesystem::path> segments,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to)
+        : Segments_(std::move(segments)),
+          From_(from),
+          To_(to)
+    { }
+
+    bool Next(TReading& reading) override {
+        while (Position_ == Buffer_.size()) {
+            if (NextSegment_ == Segments_.size()) {
+                return false;
+            }
+            Buffer_.clear();
+            Position_ = 0;
+            ReadSegment(Segments_[NextSegment_++], Buffer_);
+
+            // Only the first and the last segment reach past the range.
+            auto byTime = [] (const TReading& lhs, auto timestamp) {
+                return lhs.timestamp < timestamp;
+            };
+            Buffer_.erase(std::lower_bound(Buffer_.begin(), Buffer_.end(), To_, byTime), Buffer_.end());
+            Position_ = std::lower_bound(Buffer_.begin(), Buffer_.end(), From_, byTime) - Buffer_.begin();
+        }
+
+        reading = Buffer_[Position_++];
+        return true;
+    }
+
+private:
+    std::vector<std::filesystem::path> Segments_;
+    size_t NextSegment_ = 0;
+    std::chrono::system_clock::time_point From_;
+    std::chrono::system_clock::time_point To_;
+
+    // Reused for every segment.
+    std::vector<TReading> Buffer_;
+    size_t Position_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+TSegmentLog::TSegmentLog(std::filesystem::path directory, std::chrono::seconds segmentDuration)
+    : Directory_(std::move(directory)),
+      SegmentDuration_(segmentDuration.count())
+{
+    ASSERT(SegmentDuration_ > 0, "Segment duration must be positive");
+
+    std::filesystem::create_directories(Directory_);
+    Segments_ = ListSegments(Directory_);
+}
+
+std::deque<TReading> TSegmentLog::ReadAll() const {
+    std::deque<TReading> data;
+    std::vector<TReading> segment;
+    for (auto start : Segments_) {
+        segment.clear();
+        ReadSegment(GetSegmentPath(start), segment);
+        data.insert(data.end(), segment.begin(), segment.end());
+    }
+    return data;
+}
+
+TReadingCursorPtr TSegmentLog::OpenCursor(
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to) const
+{
+    return MakeCursor(Directory_, SegmentDuration_, Segments_, from, to);
+}
+
+TReadingCursorPtr TSegmentLog::OpenCursor(
+    const std::filesystem::path& directory,
+    std::chrono::seconds segmentDuration,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    ASSERT(segmentDuration.count() > 0, "Segment duration must be positive");
+
+    std::deque<int64_t> segments;
+    if (std::filesystem::is_directory(directory)) {
+        segments = ListSegments(directory);
+    }
+    return MakeCursor(directory, segmentDuration.count(), segments, from, to);
+}
+
+std::deque<int64_t> TSegmentLog::ListSegments(const std::filesystem::path& directory) {
+    std::deque<int64_t> segments;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (!entry.is_regular_file() || entry.path().extension() != SegmentExtension) {
+            continue;
+        }
+
+        auto stem = entry.path().stem().string();
+        int64_t start;
+        auto [ptr, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), start);
+        if (ec != std::errc() || ptr != stem.data() + stem.size()) {
+            LOG_WARNING("Skipping unknown file in segment directory (File: {})", entry.path());
+            continue;
+        }
+        segments.push_back(start);
+    }
+
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+TReadingCursorPtr TSegmentLog::MakeCursor(
+    const std::filesystem::path& directory,
+    int64_t segmentDuration,
+    const std::deque<int64_t>& segments,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    std::vector<std::filesystem::path> paths;
+    for (auto start : segments) {
+        // A segment holds readings of [start, start + duration) only.
+        std::chrono::system_clock::time_point begin{std::chrono::seconds(start)};
+        if (begin < to && begin + std::chrono::seconds(segmentDuration) > from) {
+            paths.push_back(GetSegmentPath(directory, start));
+        }
+    }
+    return std::make_unique<TCursor>(std::move(paths), from, to);
+}
+
+void TSegmentLog::ReadSegment(const std::filesystem::path& path, std::vector<TReading>& readings) {
+    size_t first = readings.size();
+    try {
+        std::ifstream fin(path, std::ios::in | std::ios::binary);
+        TRecord record;
+        while (fin.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            readings.emplace_back(
+                std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                        std::chrono::nanoseconds(record.Timestamp))),
+                record.Temperature);
+        }
+        // A trailing partial record is a torn write and is ignored.
+    } catch (std::exception& ex) {
+        LOG_WARNING("Failed to read segment (File: {}, Exception: {})", path, ex);
+    }
+
+    // Late readings are appended to the segment they belong to.
+    auto byTime = [] (const TReading& lhs, const TReading& rhs) {
+        return lhs.timestamp < rhs.timestamp;
+    };
+    if (!std::is_sorted(readings.begin() + first, readings.end(), byTime)) {
+        std::stable_sort(readings.begin() + first, readings.end(), byTime);
+    }
+}
+
+void TSegmentLog::Append(const TReading& reading) {
+    auto start = GetSegmentStart(reading.timestamp);
+    if (start != CurrentStart_) {
+        OpenSegment(start);
+    }
+
+    TRecord record{
+        std::chrono::duration_cast<std::chrono::nanoseconds>(reading.timestamp.time_since_epoch()).count(),
+        reading.temperature
+    };
+    Current_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+    if (!Current_) {
+        LOG_WARNING("Failed to append reading to segment (File: {})", GetSegmentPath(CurrentStart_));
+        Current_.clear();
+    }
+}
+
+void TSegmentLog::Flush(bool sync) {
+    // Segments closed since the last flush got their data on close.
+    if (sync) {
+        for (auto start : Closed_) {
+            if (std::filesystem::exists(GetSegmentPath(start))) {
+                NIpc::SyncFile(GetSegmentPath(start));
+            }
+        }
+    }
+    Closed_.clear();
+
+    if (CurrentStart_ == -1) {
+        return;
+    }
+
+    Current_.flush();
+    if (!Current_) {
+        LOG_WARNING("Failed to flush segment (File: {})", GetSegmentPath(CurrentStart_));
+        Current_.clear();
+        return;
+    }
+
+    if (sync) {
+        NIpc::SyncFile(GetSegmentPath(CurrentStart_));
+    }
+}
+
+void TSegmentLog::DropBefore(std::chrono::system_clock::time_point cutoff) {
+    auto cutoffSeconds = std::chrono::duration_cast<std::chrono::seconds>(cutoff.time_since_epoch()).count();
+
+    while (!Segments_.empty() && Segments_.front() + SegmentDuration_ <= cutoffSeconds) {
+        auto start = Segments_.front();
+        Segments_.pop_front();
+
+        if (start == CurrentStart_) {
+            Current_.close();
+            CurrentStart_ = -1;
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(GetSegmentPath(start), ec);
+        if (ec) {
+            LOG_WARNING("Failed to remove expired segment (File: {}, Error: {})", GetSegmentPath(start), ec.message());
+        }
+    }
+}
+
+int64_t TSegmentLog::GetSegmentStart(std::chrono::system_clock::time_point timestamp) const {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timestamp.time_since_epoch()).count();
+    auto remainder = seconds % SegmentDuration_;
+    if (remainder < 0) {
+        remainder += SegmentDuration_;
+    }
+    return seconds - remainder;
+}
+
+std::filesystem::path TSegmentLog::GetSegmentPath(const std::filesystem::path& directory, int64_t segmentStart) {
+    return directory / (std::to_string(segmentStart) + std::string(SegmentExtension));
+}
+
+std::filesystem::path TSegmentLog::GetSegmentPath(int64_t segmentStart) const {
+    return GetSegmentPath(Directory_, segmentStart);
+}
+
+void TSegmentLog::OpenSegment(int64_t segmentStart) {
+    if (CurrentStart_ != -1) {
+        Closed_.push_back(CurrentStart_);
+    }
+    Current_.close();
+    Current_.clear();
+
+    // Cut a torn record off so that appended records stay aligned.
+    auto path = GetSegmentPath(segmentStart);
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (!ec && size % sizeof(TRecord) != 0) {
+        std::filesystem::resize_file(path, size - size % sizeof(TRecord), ec);
+    }
+
+    Current_.open(path, std::ios::out | std::ios::app | std::ios::binary);
+    if (!Current_.is_open()) {
+        LOG_WARNING("Failed to open segment (File: {})", path);
+    }
+    CurrentStart_ = segmentStart;
+
+    // A late reading may open a segment older than the newest one.
+    auto position = std::lower_bound(Segments_.begin(), Segments_.end(), segmentStart);
+    if (position == Segments_.end() || *position != segmentStart) {
+        Segments_.insert(position, segmentStart);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <service/cursor.h>
+#include <service/storage.h>
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Append-only log of raw readings split into segment files by time.
+// Every segment covers a fixed span and is named by its start (unix seconds),
+// records are fixed-size binary pairs of (timestamp ns, temperature). A late
+// reading is appended to the segment of its timestamp, so records within a
+// segment may be out of order, ReadAll sorts them.
+class TSegmentLog {
+public:
+    TSegmentLog(std::filesystem::path directory, std::chrono::seconds segmentDuration);
+
+    std::deque<TReading> ReadAll() const;
+
+    // Streams the readings of [from, to) segment by segment, only one segment
+    // is held in memory at a time. Segments appended later are not seen.
+    TReadingCursorPtr OpenCursor(
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const;
+
+    // The same for a log that is not open: nothing is created, the cursor
+    // is empty if the directory is missing.
+    static TReadingCursorPtr OpenCursor(
+        const std::filesystem::path& directory,
+        std::chrono::seconds segmentDuration,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+    // Buffered, call Flush to push appended readings to the file.
+    void Append(const TReading& reading);
+
+    // Waits for the data to reach the disk when sync is set.
+    void Flush(bool sync);
+
+    // Removes segments which contain only readings older than cutoff.
+    void DropBefore(std::chrono::system_clock::time_point cutoff);
+
+private:
+    struct TRecord {
+        int64_t Timestamp;
+        double Temperature;
+    };
+
+    static_assert(sizeof(TRecord) == 16);
+
+    class TCursor;
+
+    // Appends the readings of the segment in timestamp order.
+    static void ReadSegment(const std::filesystem::path& path, std::vector<TReading>& readings);
+
+    // Starts of the segments in the directory, in order.
+    static std::deque<int64_t> ListSegments(const std::filesystem::path& directory);
+
+    static TReadingCursorPtr MakeCursor(
+        const std::filesystem::path& directory,
+        int64_t segmentDuration,
+        const std::deque<int64_t>& segments,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+    static std::filesystem::path GetSegmentPath(const std::filesystem::path& directory, int64_t segmentStart);
+
+    int64_t GetSegmentStart(std::chrono::system_clock::time_point timestamp) const;
+    std::filesystem::path GetSegmentPath(int64_t segmentStart) const;
+
+    void OpenSegment(int64_t segmentStart);
+
+    std::filesystem::path Directory_;
+    int64_t SegmentDuration_;
+
+    std::deque<int64_t> Segments_;
+    std::ofstream Current_;
+    int64_t CurrentStart_ = -1;
+
+    // Segments closed since the last flush.
+    std::vector<int64_t> Closed_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
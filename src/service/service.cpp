@@ -1,13 +1,12 @@
 #include <service/service.h>
 
-#include <service/file_storage.h>
-
 #include <common/logging.h>
 #include <common/periodic_executor.h>
 #include <common/weak_ptr.h>
 #include <common/threadpool.h>
 #include <ipc/serial_port.h>
 
+#include <array>
 #include <chrono>
 #include <deque>
 #include <mutex>
@@ -48,7 +47,7 @@ TService::TService(NConfig::TConfigPtr config, std::function<std::optional<TRead
     Decoder_ = NDecode::CreateDecoder(format);
     Decoder_->SetComPort(Port_);
 
-    Storage_ = std::make_unique<TFileStorage>(Config_->StorageConfig->FileStorageConfig);
+    Storage_ = CreateStorage(Config_->StorageConfig, Invoker_);
 }
 
 TService::~TService() {
@@ -70,17 +69,28 @@ void TService::Start() {
 
 void TService::MesureTemperature() {
     try {
-        double value = NAN;
+        // Everything a burst brought in goes to storage in one batch instead
+        // of waiting for the next ticks.
+        std::array<NDecode::TSample, MaxSamplesPerRead> samples;
+        size_t count = 0;
+
+        while (count == 0) {
+            count = Decoder_->ReadTemperatures(samples);
+        }
 
-        while (std::isnan(value)) {
-            value = Decoder_->ReadTemperature();
+        std::vector<TReading> readings;
+        readings.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            if (auto reading = Processor_(samples[i].Temperature)) {
+                readings.push_back(*reading);
+            }
         }
 
-        if (auto reading = Processor_(value)) {
+        if (!readings.empty()) {
             Invoker_->Run(NCommon::Bind(
-                &TService::ProcessTemperature,
+                &TService::ProcessTemperatures,
                 MakeWeak(this),
-                *reading
+                std::move(readings)
             ));
         }
     } catch (const NCommon::TException& ex) {
@@ -88,8 +98,8 @@ void TService::MesureTemperature() {
     }
 }
 
-void TService::ProcessTemperature(TReading reading) {
-    Storage_->ProcessTemperature(reading);
+void TService::ProcessTemperatures(const std::vector<TReading>& readings) {
+    Storage_->ProcessTemperatures(readings);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -16,6 +16,9 @@ class TService
     : public NRefCounted::TRefCountedBase
 {
 private:
+    // Samples decoded per tick at most, the rest waits in the frame buffer.
+    static constexpr size_t MaxSamplesPerRead = 64;
+
     NConfig::TConfigPtr Config_;
     NIpc::TComPortPtr Port_;
     std::unique_ptr<NDecode::TTemperatureDecoderBase> Decoder_;
@@ -30,7 +33,7 @@ private:
 
     void MesureTemperature();
 
-    void ProcessTemperature(TReading reading);
+    void ProcessTemperatures(const std::vector<TReading>& readings);
 
 public:
     TService(NConfig::TConfigPtr config, std::function<std::optional<TReading>(double)> processor);
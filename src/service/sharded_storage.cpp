@@ -0,0 +1,219 @@
+#include <service/sharded_storage.h>
+
+#include <service/column_storage.h>
+#include <service/file_storage.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+#include <algorithm>
+#include <future>
+#include <mutex>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "ShardedStorage";
+
+std::filesystem::path ShardPath(const std::filesystem::path& path, const std::string& sensorId) {
+    return path.parent_path() / sensorId / path.filename();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TShardedStorage::TShardedStorage(
+    TShardFactory factory,
+    const std::vector<std::string>& sensors,
+    NCommon::TInvokerPtr invoker)
+    : Factory_(std::move(factory))
+{
+    for (const auto& sensorId : sensors) {
+        ASSERT(IsValidSensorId(sensorId), "Invalid sensor id: '{}'", sensorId);
+    }
+
+    if (invoker) {
+        // Shards share nothing, so their files are loaded side by side.
+        std::vector<std::unique_ptr<TTemperatureStorage>> opened(sensors.size());
+        std::vector<std::future<NCommon::TErrorOr<void>>> results;
+        for (size_t index = 0; index < sensors.size(); index++) {
+            results.push_back(invoker->Run([this, &sensors, &opened, index] {
+                opened[index] = Factory_(sensors[index]);
+            }));
+        }
+
+        // Every task is awaited before any error is thrown, they use locals.
+        std::vector<NCommon::TErrorOr<void>> errors;
+        for (auto& result : results) {
+            errors.push_back(result.get());
+        }
+        for (const auto& error : errors) {
+            error.ThrowOnError();
+        }
+
+        for (size_t index = 0; index < sensors.size(); index++) {
+            Shards_.emplace(sensors[index], std::move(opened[index]));
+        }
+    } else {
+        for (const auto& sensorId : sensors) {
+            Shards_.emplace(sensorId, Factory_(sensorId));
+        }
+    }
+
+    LOG_INFO("Sharded storage opened (Sensors: {})", Shards_.size());
+}
+
+TTemperatureStorage& TShardedStorage::GetShard(const std::string& sensorId) {
+    {
+        std::shared_lock lock(Lock_);
+        auto it = Shards_.find(sensorId);
+        if (it != Shards_.end()) {
+            return *it->second;
+        }
+    }
+
+    ASSERT(IsValidSensorId(sensorId), "Invalid sensor id: '{}'", sensorId);
+
+    // Opening under the exclusive lock makes sure a shard's files are never
+    // opened twice. This happens once per sensor.
+    std::unique_lock lock(Lock_);
+    auto& shard = Shards_[sensorId];
+    if (!shard) {
+        shard = Factory_(sensorId);
+        LOG_INFO("Opened shard for new sensor (Sensor: {})", sensorId);
+    }
+    return *shard;
+}
+
+std::vector<std::string> TShardedStorage::ListSensors() const {
+    std::vector<std::string> sensors;
+    {
+        std::shared_lock lock(Lock_);
+        for (const auto& [sensorId, shard] : Shards_) {
+            sensors.push_back(sensorId);
+        }
+    }
+    std::sort(sensors.begin(), sensors.end());
+    return sensors;
+}
+
+void TShardedStorage::ProcessTemperature(const std::string& sensorId, const TReading& reading) {
+    GetShard(sensorId).ProcessTemperature(reading);
+}
+
+void TShardedStorage::ProcessTemperatures(const std::string& sensorId, std::span<const TReading> readings) {
+    GetShard(sensorId).ProcessTemperatures(readings);
+}
+
+TStorageSnapshot TShardedStorage::GetSnapshot(const std::string& sensorId) {
+    return GetShard(sensorId).GetSnapshot();
+}
+
+TReadingRange TShardedStorage::GetRange(
+    const std::string& sensorId,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    return GetShard(sensorId).GetRange(tier, from, to);
+}
+
+TReadingCursorPtr TShardedStorage::OpenCursor(
+    const std::string& sensorId,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    return GetShard(sensorId).OpenCursor(tier, from, to);
+}
+
+std::vector<TReading> TShardedStorage::GetDownsampled(
+    const std::string& sensorId,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to,
+    size_t maxPoints)
+{
+    return GetShard(sensorId).GetDownsampled(tier, from, to, maxPoints);
+}
+
+std::vector<TReading> TShardedStorage::GetByValue(
+    const std::string& sensorId,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to,
+    double low,
+    double high)
+{
+    return GetShard(sensorId).GetByValue(tier, from, to, low, high);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IsValidSensorId(const std::string& sensorId) {
+    if (sensorId.empty() || sensorId == "." || sensorId == "..") {
+        return false;
+    }
+    return std::all_of(sensorId.begin(), sensorId.end(), [] (char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '-' || c == '_' || c == '.';
+    });
+}
+
+NConfig::TFileStorageConfigPtr MakeShardConfig(const NConfig::TFileStorageConfigPtr& config, const std::string& sensorId) {
+    // Everything is copied, so that new settings reach the shards, and only
+    // the paths are made per sensor. Configs with paths are copied too.
+    auto shardConfig = NCommon::New<NConfig::TFileStorageConfig>();
+    *shardConfig = *config;
+    shardConfig->TemperaturePath = ShardPath(config->TemperaturePath, sensorId);
+    shardConfig->TemperatureHourPath = ShardPath(config->TemperatureHourPath, sensorId);
+    shardConfig->TemperatureDayPath = ShardPath(config->TemperatureDayPath, sensorId);
+
+    if (config->JournalConfig) {
+        shardConfig->JournalConfig = NCommon::New<NConfig::TJournalConfig>();
+        *shardConfig->JournalConfig = *config->JournalConfig;
+        shardConfig->JournalConfig->Path = config->JournalConfig->Path / sensorId;
+    }
+
+    if (config->LadderConfig) {
+        shardConfig->LadderConfig = NCommon::New<NConfig::TLadderConfig>();
+        *shardConfig->LadderConfig = *config->LadderConfig;
+        shardConfig->LadderConfig->Path = ShardPath(config->LadderConfig->Path, sensorId);
+    }
+
+    return shardConfig;
+}
+
+NConfig::TColumnStorageConfigPtr MakeShardConfig(const NConfig::TColumnStorageConfigPtr& config, const std::string& sensorId) {
+    auto shardConfig = NCommon::New<NConfig::TColumnStorageConfig>();
+    *shardConfig = *config;
+    shardConfig->Path = config->Path / sensorId;
+    return shardConfig;
+}
+
+std::unique_ptr<TShardedStorage> CreateShardedStorage(NConfig::TStorageConfigPtr config, NCommon::TInvokerPtr invoker) {
+    TShardedStorage::TShardFactory factory;
+    if (config->ColumnStorageConfig) {
+        factory = [config] (const std::string& sensorId) -> std::unique_ptr<TTemperatureStorage> {
+            return std::make_unique<TColumnStorage>(MakeShardConfig(config->ColumnStorageConfig, sensorId));
+        };
+    } else {
+        // Shards do not get the invoker: they may be opened on it, and waiting
+        // there for nested tasks could starve the pool.
+        factory = [config] (const std::string& sensorId) -> std::unique_ptr<TTemperatureStorage> {
+            return std::make_unique<TFileStorage>(MakeShardConfig(config->FileStorageConfig, sensorId));
+        };
+    }
+
+    return std::make_unique<TShardedStorage>(std::move(factory), config->Sensors, std::move(invoker));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <service/storage.h>
+#include <service/config.h>
+
+#include <common/threadpool.h>
+
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// One independent storage per sensor. Every shard has its own cache, locks,
+// files and writer, so readings of different sensors never wait for each
+// other. Shards are opened on first use and live as long as the storage.
+class TShardedStorage {
+public:
+    using TShardFactory = std::function<std::unique_ptr<TTemperatureStorage>(const std::string& sensorId)>;
+
+    // The listed sensors are opened right away, in parallel on the invoker
+    // when it is given.
+    TShardedStorage(
+        TShardFactory factory,
+        const std::vector<std::string>& sensors = {},
+        NCommon::TInvokerPtr invoker = NCommon::TInvokerPtr());
+
+    // The returned shard stays valid while the storage lives, ingest loops
+    // should resolve it once and skip the lookup afterwards.
+    TTemperatureStorage& GetShard(const std::string& sensorId);
+
+    std::vector<std::string> ListSensors() const;
+
+    void ProcessTemperature(const std::string& sensorId, const TReading& reading);
+    void ProcessTemperatures(const std::string& sensorId, std::span<const TReading> readings);
+
+    TStorageSnapshot GetSnapshot(const std::string& sensorId);
+
+    TReadingRange GetRange(
+        const std::string& sensorId,
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+    TReadingCursorPtr OpenCursor(
+        const std::string& sensorId,
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to);
+
+    std::vector<TReading> GetDownsampled(
+        const std::string& sensorId,
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to,
+        size_t maxPoints);
+
+    std::vector<TReading> GetByValue(
+        const std::string& sensorId,
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to,
+        double low,
+        double high);
+
+private:
+    TShardFactory Factory_;
+
+    // Guards the map only, shards are used outside of it.
+    mutable std::shared_mutex Lock_;
+    std::unordered_map<std::string, std::unique_ptr<TTemperatureStorage>> Shards_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Sensor ids become directory names: non-empty, letters, digits, '-', '_'
+// and '.', but not "." or "..".
+bool IsValidSensorId(const std::string& sensorId);
+
+// Shards keep their files next to the configured ones, in a subdirectory
+// named after the sensor: data/hourly.log becomes data/<sensor>/hourly.log.
+NConfig::TFileStorageConfigPtr MakeShardConfig(const NConfig::TFileStorageConfigPtr& config, const std::string& sensorId);
+NConfig::TColumnStorageConfigPtr MakeShardConfig(const NConfig::TColumnStorageConfigPtr& config, const std::string& sensorId);
+
+std::unique_ptr<TShardedStorage> CreateShardedStorage(NConfig::TStorageConfigPtr config, NCommon::TInvokerPtr invoker = NCommon::TInvokerPtr());
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,205 @@
+#include <service/sketch.h>
+
+#include <common/exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T Get(std::string_view& data) {
+    ASSERT(data.size() >= sizeof(T), "Quantile sketch is truncated");
+    T value;
+    std::memcpy(&value, data.data(), sizeof(T));
+    data.remove_prefix(sizeof(T));
+    return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TQuantileSketch::TStore::Add(int32_t index, uint64_t count) {
+    if (Bins.empty()) {
+        Offset = index;
+        Bins.assign(1, 0);
+    }
+
+    if (index < Offset) {
+        if (Offset + static_cast<int64_t>(Bins.size()) - index > static_cast<int64_t>(MaxBins)) {
+            // Too wide: the value goes to the lowest bin instead.
+            index = Offset;
+        } else {
+            Bins.insert(Bins.begin(), Offset - index, 0);
+            Offset = index;
+        }
+    } else if (index >= Offset + static_cast<int64_t>(Bins.size())) {
+        size_t size = index - Offset + 1;
+        if (size > MaxBins) {
+            // Fold the lowest bins so that the new one fits.
+            size_t fold = size - MaxBins;
+            uint64_t folded = 0;
+            for (size_t i = 0; i <= std::min(fold, Bins.size() - 1); i++) {
+                folded += Bins[i];
+            }
+            Bins.erase(Bins.begin(), Bins.begin() + std::min(fold, Bins.size()));
+            Offset += fold;
+            if (Bins.empty()) {
+                Bins.assign(1, 0);
+            }
+            Bins[0] = folded;
+            size = MaxBins;
+        }
+        Bins.resize(size, 0);
+    }
+
+    Bins[index - Offset] += count;
+}
+
+void TQuantileSketch::TStore::Merge(const TStore& other) {
+    for (size_t i = 0; i < other.Bins.size(); i++) {
+        if (other.Bins[i]) {
+            Add(other.Offset + static_cast<int32_t>(i), other.Bins[i]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TQuantileSketch::TQuantileSketch()
+    : TQuantileSketch(DefaultAccuracy)
+{ }
+
+TQuantileSketch::TQuantileSketch(double accuracy)
+    : Accuracy_(accuracy),
+      Gamma_((1 + accuracy) / (1 - accuracy)),
+      LogGamma_(std::log(Gamma_))
+{
+    ASSERT(accuracy > 0 && accuracy < 1, "Sketch accuracy must be in (0, 1)");
+}
+
+void TQuantileSketch::Add(double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+
+    if (value > MinIndexable) {
+        Positive_.Add(GetIndex(value), 1);
+    } else if (value < -MinIndexable) {
+        Negative_.Add(GetIndex(-value), 1);
+    } else {
+        ZeroCount_++;
+    }
+    Count_++;
+}
+
+void TQuantileSketch::Merge(const TQuantileSketch& other) {
+    if (other.Empty()) {
+        return;
+    }
+    ASSERT(Accuracy_ == other.Accuracy_, "Cannot merge sketches of different accuracy");
+
+    Positive_.Merge(other.Positive_);
+    Negative_.Merge(other.Negative_);
+    ZeroCount_ += other.ZeroCount_;
+    Count_ += other.Count_;
+}
+
+uint64_t TQuantileSketch::GetCount() const {
+    return Count_;
+}
+
+bool TQuantileSketch::Empty() const {
+    return Count_ == 0;
+}
+
+double TQuantileSketch::GetAccuracy() const {
+    return Accuracy_;
+}
+
+double TQuantileSketch::GetQuantile(double q) const {
+    if (Empty()) {
+        return NAN;
+    }
+
+    double rank = std::clamp(q, 0.0, 1.0) * static_cast<double>(Count_ - 1);
+    uint64_t seen = 0;
+
+    // Negative bins go from the largest magnitude down.
+    for (size_t i = Negative_.Bins.size(); i-- > 0;) {
+        seen += Negative_.Bins[i];
+        if (static_cast<double>(seen) > rank) {
+            return -GetValue(Negative_.Offset + static_cast<int32_t>(i));
+        }
+    }
+
+    seen += ZeroCount_;
+    if (static_cast<double>(seen) > rank) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < Positive_.Bins.size(); i++) {
+        seen += Positive_.Bins[i];
+        if (static_cast<double>(seen) > rank) {
+            return GetValue(Positive_.Offset + static_cast<int32_t>(i));
+        }
+    }
+
+    return GetValue(Positive_.Offset + static_cast<int32_t>(Positive_.Bins.size()) - 1);
+}
+
+void TQuantileSketch::Save(std::string& out) const {
+    Put<double>(out, Accuracy_);
+    Put<uint64_t>(out, ZeroCount_);
+    for (const auto* store : {&Negative_, &Positive_}) {
+        Put<int32_t>(out, store->Offset);
+        Put<uint32_t>(out, store->Bins.size());
+        out.append(reinterpret_cast<const char*>(store->Bins.data()), store->Bins.size() * sizeof(uint64_t));
+    }
+}
+
+TQuantileSketch TQuantileSketch::Load(std::string_view& data) {
+    TQuantileSketch sketch(Get<double>(data));
+    sketch.ZeroCount_ = Get<uint64_t>(data);
+    sketch.Count_ = sketch.ZeroCount_;
+    for (auto* store : {&sketch.Negative_, &sketch.Positive_}) {
+        store->Offset = Get<int32_t>(data);
+        auto size = Get<uint32_t>(data);
+        ASSERT(size <= MaxBins && size * sizeof(uint64_t) <= data.size(), "Quantile sketch is truncated");
+        store->Bins.resize(size);
+        if (size) {
+            std::memcpy(store->Bins.data(), data.data(), size * sizeof(uint64_t));
+        }
+        data.remove_prefix(size * sizeof(uint64_t));
+        for (auto count : store->Bins) {
+            sketch.Count_ += count;
+        }
+    }
+    return sketch;
+}
+
+int32_t TQuantileSketch::GetIndex(double value) const {
+    return static_cast<int32_t>(std::ceil(std::log(value) / LogGamma_));
+}
+
+double TQuantileSketch::GetValue(int32_t index) const {
+    // Midpoint in relative terms of (gamma^(i-1), gamma^i].
+    return 2 * std::pow(Gamma_, index) / (Gamma_ + 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
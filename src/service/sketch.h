@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// DDSketch: quantiles with a bounded relative error. Values are counted in
+// logarithmic bins, bin i of the positive side covers (gamma^(i-1), gamma^i]
+// with gamma = (1 + accuracy) / (1 - accuracy), negative values mirror it.
+// Merging adds bin counts, so a merged sketch equals one fed with all values.
+class TQuantileSketch {
+public:
+    static constexpr double DefaultAccuracy = 0.01;
+
+    TQuantileSketch();
+    explicit TQuantileSketch(double accuracy);
+
+    void Add(double value);
+
+    // Both sketches must have the same accuracy.
+    void Merge(const TQuantileSketch& other);
+
+    uint64_t GetCount() const;
+    bool Empty() const;
+    double GetAccuracy() const;
+
+    // Value at rank q * (count - 1), within the relative accuracy of the
+    // true quantile. NaN when empty.
+    double GetQuantile(double q) const;
+
+    void Save(std::string& out) const;
+    static TQuantileSketch Load(std::string_view& data);
+
+private:
+    // Contiguous run of bins starting at Offset.
+    struct TStore {
+        int32_t Offset = 0;
+        std::vector<uint64_t> Bins;
+
+        void Add(int32_t index, uint64_t count);
+        void Merge(const TStore& other);
+    };
+
+    // Keeps a sketch fed with outliers of every magnitude small, the lowest
+    // bins are folded together past this limit.
+    static constexpr size_t MaxBins = 2048;
+
+    // Values closer to zero than this share one bin.
+    static constexpr double MinIndexable = 1e-9;
+
+    int32_t GetIndex(double value) const;
+    double GetValue(int32_t index) const;
+
+    double Accuracy_;
+    double Gamma_;
+    double LogGamma_;
+
+    TStore Positive_;
+    TStore Negative_;
+    uint64_t ZeroCount_ = 0;
+    uint64_t Count_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,19 @@
+#include <service/storage.h>
+
+#include <service/column_storage.h>
+#include <service/file_storage.h>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<TTemperatureStorage> CreateStorage(NConfig::TStorageConfigPtr config, NCommon::TInvokerPtr invoker) {
+    if (config->ColumnStorageConfig) {
+        return std::make_unique<TColumnStorage>(config->ColumnStorageConfig);
+    }
+    return std::make_unique<TFileStorage>(config->FileStorageConfig, std::move(invoker));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -1,36 +1,246 @@
 #pragma once
 
+#include <service/aggregation.h>
+#include <service/config.h>
+#include <service/cursor.h>
+#include <service/downsample.h>
+#include <service/reading.h>
+
 #include <common/refcounted.h>
 #include <common/intrusive_ptr.h>
+#include <common/threadpool.h>
 
+#include <chrono>
 #include <deque>
+#include <memory>
+#include <span>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
 
-struct TReading {
-    std::chrono::system_clock::time_point timestamp;
-    double temperature;
-};
+inline constexpr auto RawRetention = std::chrono::days(1);
+inline constexpr auto HourlyRetention = std::chrono::days(30);
+inline constexpr auto DailyRetention = std::chrono::days(360);
 
 struct TCache
     : NRefCounted::TRefCountedBase
 {
-    std::deque<TReading> rawReadings;
-    std::deque<TReading> hourlyAverages;
-    std::deque<TReading> dailyAverages;
+    TReadingSequence rawReadings;
+    TReadingSequence hourlyAverages;
+    TReadingSequence dailyAverages;
+
+    // Readings behind the closed averages, for correcting them. Averages
+    // loaded from tier files have none.
+    NService::TBucketCountSequence hourlyCounts;
+    NService::TBucketCountSequence dailyCounts;
+
+    // Open hourly and daily buckets.
+    NService::TRollup rollup;
+
+    // Summary tiers, empty unless configured.
+    NService::TRollupLadder ladder;
+
+    const TReadingSequence& GetTier(ETier tier) const {
+        switch (tier) {
+            case ETier::Hourly:
+                return hourlyAverages;
+            case ETier::Daily:
+                return dailyAverages;
+            case ETier::Raw:
+            default:
+                return rawReadings;
+        }
+    }
 };
 
 DECLARE_REFCOUNTED(TCache);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Read-only view of the storage at one point in time. The tier ranges keep
+// what they read alive, so they stay valid while the handle lives, no matter
+// how many readings are processed meanwhile.
+class TStorageSnapshot {
+public:
+    explicit TStorageSnapshot(TCachePtr cache)
+        : Raw_(cache->rawReadings, 0, cache->rawReadings.size()),
+          Hourly_(cache->hourlyAverages, 0, cache->hourlyAverages.size()),
+          Daily_(cache->dailyAverages, 0, cache->dailyAverages.size()),
+          Cache_(std::move(cache))
+    { }
+
+    // Tiers the backend serves in place, e.g. from mapped columns. Such a
+    // snapshot has no ladder.
+    TStorageSnapshot(TReadingRange raw, TReadingRange hourly, TReadingRange daily)
+        : Raw_(std::move(raw)),
+          Hourly_(std::move(hourly)),
+          Daily_(std::move(daily))
+    { }
+
+    const TReadingRange& GetRawReadings() const { return Raw_; }
+    const TReadingRange& GetHourlyAverage() const { return Hourly_; }
+    const TReadingRange& GetDailyAverage() const { return Daily_; }
+
+    const TReadingRange& GetTier(ETier tier) const {
+        switch (tier) {
+            case ETier::Hourly:
+                return Hourly_;
+            case ETier::Daily:
+                return Daily_;
+            case ETier::Raw:
+            default:
+                return Raw_;
+        }
+    }
+
+    TReadingRange GetRange(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const
+    {
+        return GetTier(tier).Slice(from, to);
+    }
+
+    NService::TReadingCursorPtr OpenCursor(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const
+    {
+        return std::make_unique<NService::TRangeCursor>(GetRange(tier, from, to));
+    }
+
+    // At most maxPoints readings of [from, to) for plotting, see DownsampleLttb.
+    std::vector<TReading> GetDownsampled(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to,
+        size_t maxPoints) const
+    {
+        return NService::DownsampleLttb(GetRange(tier, from, to), maxPoints);
+    }
+
+    // Readings of [from, to) with low <= temperature <= high, e.g. the
+    // excursions above a threshold. See TReadingRange::ScanValues.
+    std::vector<TReading> GetByValue(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to,
+        double low,
+        double high) const
+    {
+        std::vector<TReading> result;
+        GetRange(tier, from, to).ScanValues(low, high, [&] (const TReading& reading) {
+            result.push_back(reading);
+        });
+        return result;
+    }
+
+    const NService::TRollupLadder& GetLadder() const {
+        static const NService::TRollupLadder EmptyLadder;
+        return Cache_ ? Cache_->ladder : EmptyLadder;
+    }
+
+    // Count, sum, min, max and variance of the readings in [from, to),
+    // answered from the coarsest summaries that fit.
+    NService::TAggregate Summarize(
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const
+    {
+        return GetLadder().Summarize(from, to, Raw_);
+    }
+
+    // Percentiles of the readings in [from, to) within the sketch accuracy.
+    NService::TQuantileSketch GetQuantileSketch(
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) const
+    {
+        return GetLadder().GetQuantileSketch(from, to, Raw_);
+    }
+
+private:
+    TReadingRange Raw_;
+    TReadingRange Hourly_;
+    TReadingRange Daily_;
+
+    // Holds the ladder, null for backends without one.
+    TCachePtr Cache_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class TTemperatureStorage {
 public:
-    virtual const std::deque<TReading>& GetRawReadings() = 0;
-    virtual const std::deque<TReading>& GetHourlyAverage() = 0;
-    virtual const std::deque<TReading>& GetDailyAverage() = 0;
+    virtual ~TTemperatureStorage() = default;
+
+    virtual TStorageSnapshot GetSnapshot() = 0;
+
+    // Copies are O(1) and hold what the snapshot reads, so the result
+    // outlives it safely.
+    TReadingRange GetRawReadings() { return GetSnapshot().GetRawReadings(); }
+    TReadingRange GetHourlyAverage() { return GetSnapshot().GetHourlyAverage(); }
+    TReadingRange GetDailyAverage() { return GetSnapshot().GetDailyAverage(); }
+
+    // Readings of the tier with from <= timestamp < to in O(log n + k).
+    virtual TReadingRange GetRange(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to) = 0;
+
+    // Streams the readings of [from, to). Backends that keep their tiers on
+    // disk read them block by block, the others walk GetRange.
+    virtual NService::TReadingCursorPtr OpenCursor(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to)
+    {
+        return std::make_unique<NService::TRangeCursor>(GetRange(tier, from, to));
+    }
+
+    // At most maxPoints readings of [from, to) for plotting, see DownsampleLttb.
+    std::vector<TReading> GetDownsampled(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to,
+        size_t maxPoints)
+    {
+        return NService::DownsampleLttb(GetRange(tier, from, to), maxPoints);
+    }
+
+    // Readings of [from, to) with low <= temperature <= high.
+    std::vector<TReading> GetByValue(
+        ETier tier,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to,
+        double low,
+        double high)
+    {
+        std::vector<TReading> result;
+        GetRange(tier, from, to).ScanValues(low, high, [&] (const TReading& reading) {
+            result.push_back(reading);
+        });
+        return result;
+    }
 
     virtual void ProcessTemperature(const TReading& reading) = 0;
+
+    // Readings that arrived together, in arrival order. Backends override it
+    // to publish and persist the batch once instead of after every reading.
+    virtual void ProcessTemperatures(std::span<const TReading> readings) {
+        for (const auto& reading : readings) {
+            ProcessTemperature(reading);
+        }
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The invoker, if given, is used for parallel startup work.
+std::unique_ptr<TTemperatureStorage> CreateStorage(NConfig::TStorageConfigPtr config, NCommon::TInvokerPtr invoker = NCommon::TInvokerPtr());
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
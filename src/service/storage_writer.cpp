@@ -0,0 +1,142 @@
+#include <service/storage_writer.h>
+
+#include <common/exception.h>
+#include <common/logging.h>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline const std::string LoggingSource = "StorageWriter";
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+TStorageWriter::TStorageWriter(
+    NConfig::TStorageWriterConfigPtr config,
+    TCommitCallback commit,
+    TTickCallback tick,
+    std::chrono::milliseconds tickInterval)
+    : Config_(std::move(config)),
+      Commit_(std::move(commit)),
+      Tick_(std::move(tick)),
+      TickInterval_(tickInterval)
+{
+    ASSERT(!Tick_ || TickInterval_.count() > 0, "Tick interval must be positive");
+
+    Thread_ = std::thread(&TStorageWriter::Run, this);
+}
+
+TStorageWriter::~TStorageWriter() {
+    {
+        std::lock_guard lock(Lock_);
+        Stopped_ = true;
+    }
+    WakeUp_.notify_one();
+    Thread_.join();
+}
+
+void TStorageWriter::Enqueue(TBatch batch) {
+    bool full = false;
+    {
+        std::lock_guard lock(Lock_);
+        if (Pending_.GetSize() == 0) {
+            PendingSince_ = std::chrono::steady_clock::now();
+        }
+        EnqueuedCount_ += batch.GetSize();
+        Pending_.Readings.insert(Pending_.Readings.end(), batch.Readings.begin(), batch.Readings.end());
+        Pending_.Applied.insert(Pending_.Applied.end(), batch.Applied.begin(), batch.Applied.end());
+        Pending_.Held = std::move(batch.Held);
+        Pending_.Cache = std::move(batch.Cache);
+        Pending_.HourlyChanged |= batch.HourlyChanged;
+        Pending_.DailyChanged |= batch.DailyChanged;
+        Pending_.LadderChanged |= batch.LadderChanged;
+        Pending_.Corrected |= batch.Corrected;
+        full = Pending_.GetSize() >= Config_->MaxBatchSize;
+    }
+    if (full || Config_->CommitInterval.count() == 0) {
+        WakeUp_.notify_one();
+    }
+}
+
+void TStorageWriter::Flush() {
+    std::unique_lock lock(Lock_);
+    auto target = EnqueuedCount_;
+    FlushRequested_ = true;
+    WakeUp_.notify_one();
+    Committed_.wait(lock, [&] { return CommittedCount_ >= target; });
+}
+
+TStorageWriter::TStatistics TStorageWriter::GetStatistics() const {
+    std::lock_guard lock(Lock_);
+    auto statistics = Statistics_;
+    statistics.QueueDepth = Pending_.GetSize();
+    return statistics;
+}
+
+void TStorageWriter::Run() {
+    bool sync = Config_->Fsync == NConfig::EFsyncPolicy::Commit;
+
+    std::unique_lock lock(Lock_);
+    while (true) {
+        auto hasWork = [&] { return Stopped_ || FlushRequested_ || Pending_.GetSize() > 0; };
+        if (!Tick_) {
+            WakeUp_.wait(lock, hasWork);
+        } else if (!WakeUp_.wait_for(lock, TickInterval_, hasWork)) {
+            lock.unlock();
+            try {
+                Tick_();
+            } catch (const std::exception& ex) {
+                LOG_ERROR("Writer tick failed (Exception: {})", ex);
+            }
+            lock.lock();
+            continue;
+        }
+
+        WakeUp_.wait_until(lock, PendingSince_ + Config_->CommitInterval, [&] {
+            return Stopped_ || FlushRequested_ || Pending_.GetSize() >= Config_->MaxBatchSize;
+        });
+
+        FlushRequested_ = false;
+        if (Pending_.GetSize() == 0) {
+            Committed_.notify_all();
+            if (Stopped_) {
+                return;
+            }
+            continue;
+        }
+
+        TBatch batch = std::move(Pending_);
+        Pending_ = TBatch();
+        auto committedCount = EnqueuedCount_;
+
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        try {
+            Commit_(batch, sync);
+        } catch (const std::exception& ex) {
+            LOG_ERROR("Failed to commit readings (Count: {}, Exception: {})", batch.GetSize(), ex);
+        }
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        lock.lock();
+
+        CommittedCount_ = committedCount;
+        Statistics_.Commits++;
+        Statistics_.CommittedReadings += batch.GetSize();
+        Statistics_.LastCommitLatency = latency;
+        Statistics_.MaxCommitLatency = std::max(Statistics_.MaxCommitLatency, latency);
+        Committed_.notify_all();
+
+        LOG_DEBUG("Committed readings (Count: {}, Latency: {} us, Queue depth: {})",
+            batch.GetSize(), latency.count(), Pending_.GetSize());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <service/config.h>
+#include <service/storage.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Group commit stage between ingest and disk.
+// Enqueue returns immediately; a dedicated thread merges everything pending
+// into one batch and commits it when the batch is full or the commit interval
+// has passed since its first reading, so one flush covers many readings.
+class TStorageWriter {
+public:
+    struct TBatch {
+        // Raw readings in arrival order, before reordering.
+        std::vector<TReading> Readings;
+        // Raw readings in the order they were applied to the cache.
+        std::vector<TReading> Applied;
+        // Readings held for reordering at the newest state, not in it yet.
+        std::vector<TReading> Held;
+        // Newest state, rewritten tiers are taken from it.
+        TCachePtr Cache;
+        bool HourlyChanged = false;
+        bool DailyChanged = false;
+        bool LadderChanged = false;
+        // Some reading was late and updated buckets in place.
+        bool Corrected = false;
+
+        size_t GetSize() const { return std::max(Readings.size(), Applied.size()); }
+    };
+
+    struct TStatistics {
+        size_t QueueDepth = 0;
+        uint64_t Commits = 0;
+        uint64_t CommittedReadings = 0;
+        std::chrono::microseconds LastCommitLatency{0};
+        std::chrono::microseconds MaxCommitLatency{0};
+    };
+
+    // Called on the writer thread only, sync tells whether to fsync.
+    using TCommitCallback = std::function<void(const TBatch& batch, bool sync)>;
+
+    // Called on the writer thread after it has been idle for the tick
+    // interval, e.g. to release readings of a quiet sensor.
+    using TTickCallback = std::function<void()>;
+
+    TStorageWriter(
+        NConfig::TStorageWriterConfigPtr config,
+        TCommitCallback commit,
+        TTickCallback tick = TTickCallback(),
+        std::chrono::milliseconds tickInterval = std::chrono::milliseconds(0));
+
+    // Commits everything still pending before returning.
+    ~TStorageWriter();
+
+    // Merged into the pending batch, the cache and held readings of the
+    // newest batch replace the older ones.
+    void Enqueue(TBatch batch);
+
+    // Blocks until everything enqueued so far is committed.
+    void Flush();
+
+    TStatistics GetStatistics() const;
+
+private:
+    void Run();
+
+    NConfig::TStorageWriterConfigPtr Config_;
+    TCommitCallback Commit_;
+    TTickCallback Tick_;
+    std::chrono::milliseconds TickInterval_;
+
+    mutable std::mutex Lock_;
+    std::condition_variable WakeUp_;
+    std::condition_variable Committed_;
+
+    TBatch Pending_;
+    std::chrono::steady_clock::time_point PendingSince_;
+    uint64_t EnqueuedCount_ = 0;
+    uint64_t CommittedCount_ = 0;
+    bool FlushRequested_ = false;
+    bool Stopped_ = false;
+
+    TStatistics Statistics_;
+
+    std::thread Thread_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,154 @@
+#include <service/text_format.h>
+
+#include <charconv>
+#include <cstring>
+
+namespace NService {
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+constexpr std::string_view TimestampPattern = "0000-00-00T00:00:00Z";
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+int Digits(std::string_view text, size_t offset, size_t count) {
+    int value = 0;
+    for (size_t i = offset; i < offset + count; i++) {
+        value = value * 10 + (text[i] - '0');
+    }
+    return value;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar (H. Hinnant).
+int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+// Inverse of DaysFromCivil.
+void CivilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+}
+
+char* PutTwoDigits(char* out, unsigned value) {
+    out[0] = static_cast<char>('0' + value / 10);
+    out[1] = static_cast<char>('0' + value % 10);
+    return out + 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::optional<TReading> ParseReading(std::string_view line) {
+    while (!line.empty() && IsSpace(line.front())) {
+        line.remove_prefix(1);
+    }
+    while (!line.empty() && IsSpace(line.back())) {
+        line.remove_suffix(1);
+    }
+
+    if (line.size() <= TimestampPattern.size()) {
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < TimestampPattern.size(); i++) {
+        bool digit = line[i] >= '0' && line[i] <= '9';
+        if (TimestampPattern[i] == '0' ? !digit : line[i] != TimestampPattern[i]) {
+            return std::nullopt;
+        }
+    }
+
+    int year = Digits(line, 0, 4);
+    int month = Digits(line, 5, 2);
+    int day = Digits(line, 8, 2);
+    int hour = Digits(line, 11, 2);
+    int minute = Digits(line, 14, 2);
+    int second = Digits(line, 17, 2);
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return std::nullopt;
+    }
+
+    auto value = line.substr(TimestampPattern.size());
+    if (!IsSpace(value.front())) {
+        return std::nullopt;
+    }
+    while (IsSpace(value.front())) {
+        value.remove_prefix(1);
+    }
+
+    double temperature;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), temperature);
+    if (ec != std::errc() || ptr != value.data() + value.size()) {
+        return std::nullopt;
+    }
+
+    int64_t seconds = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return TReading(std::chrono::system_clock::time_point(std::chrono::seconds(seconds)), temperature);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+char* TReadingFormatter::Format(const TReading& reading, char* buffer) {
+    // to_time_t truncates towards zero, keep that for pre-epoch readings.
+    int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(reading.timestamp.time_since_epoch()).count();
+    int64_t day = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    int64_t secondOfDay = seconds - day * 86400;
+
+    if (day != Day_) {
+        int64_t year;
+        unsigned month, dayOfMonth;
+        CivilFromDays(day, year, month, dayOfMonth);
+
+        // %Y is not padded, like strftime.
+        char* out = std::to_chars(Prefix_, Prefix_ + sizeof(Prefix_), year).ptr;
+        *out++ = '-';
+        out = PutTwoDigits(out, month);
+        *out++ = '-';
+        out = PutTwoDigits(out, dayOfMonth);
+        *out++ = 'T';
+        PrefixSize_ = out - Prefix_;
+        Day_ = day;
+    }
+
+    char* out = buffer;
+    std::memcpy(out, Prefix_, PrefixSize_);
+    out += PrefixSize_;
+    out = PutTwoDigits(out, static_cast<unsigned>(secondOfDay / 3600));
+    *out++ = ':';
+    out = PutTwoDigits(out, static_cast<unsigned>(secondOfDay / 60 % 60));
+    *out++ = ':';
+    out = PutTwoDigits(out, static_cast<unsigned>(secondOfDay % 60));
+    *out++ = 'Z';
+    *out++ = ' ';
+
+    constexpr int Precision = std::numeric_limits<double>::digits10 + 1;
+    return std::to_chars(out, buffer + MaxLength, reading.temperature, std::chars_format::fixed, Precision).ptr;
+}
+
+std::string ReadingToString(const TReading& reading) {
+    char buffer[TReadingFormatter::MaxLength];
+    TReadingFormatter formatter;
+    return std::string(buffer, formatter.Format(reading, buffer));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <service/reading.h>
+
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace NService {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Text tier format: one "YYYY-MM-DDTHH:MM:SSZ value" line per reading, UTC.
+
+// Parses one line without locale, streams or allocations.
+// Returns nullopt if the line is malformed.
+std::optional<TReading> ParseReading(std::string_view line);
+
+// Formats readings into a caller-provided buffer with std::to_chars, output
+// matches put_time + fixed/setprecision(16) byte for byte. The date part is
+// cached, so readings of the same day only format the time and value.
+class TReadingFormatter {
+public:
+    // Enough for any timestamp and a fixed-notation double.
+    static constexpr size_t MaxLength = 400;
+
+    // Writes the line without a newline, returns the end of the written text.
+    char* Format(const TReading& reading, char* buffer);
+
+private:
+    int64_t Day_ = std::numeric_limits<int64_t>::min();
+    char Prefix_[32];
+    size_t PrefixSize_ = 0;
+};
+
+std::string ReadingToString(const TReading& reading);
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace NService
@@ -0,0 +1,764 @@
+#include <service/compression.h>
+#include <service/file_storage.h>
+#include <service/sharded_storage.h>
+#include <service/sketch.h>
+#include <service/storage.h>
+#include <service/text_format.h>
+
+#include <common/exception.h>
+#include <common/getopts.h>
+#include <common/logging.h>
+#include <common/threadpool.h>
+#include <ipc/decode_encode.h>
+
+#include <nlohmann/json.hpp>
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+time_t timegm(struct tm* tm) {
+    _tzset();
+    return _mkgmtime(tm);
+}
+#endif
+
+using TClock = std::chrono::steady_clock;
+
+double SecondsSince(TClock::time_point start) {
+    return std::chrono::duration<double>(TClock::now() - start).count();
+}
+
+TReading SyntheticReading(std::chrono::system_clock::time_point start, std::chrono::milliseconds step, size_t index) {
+    double phase = 2 * M_PI * static_cast<double>(index * step.count()) / 86400000;
+    return {start + index * step, 20 + 10 * std::sin(phase) + 0.01 * static_cast<double>(index % 17)};
+}
+
+// The serializer the storage used before: put_time, gmtime, setprecision.
+std::string FormatWithStreams(const TReading& reading) {
+    auto time = std::chrono::system_clock::to_time_t(reading.timestamp);
+    std::ostringstream oss;
+    oss << std::put_time(gmtime(&time), "%Y-%m-%dT%H:%M:%SZ") << " "
+        << std::fixed << std::setprecision(std::numeric_limits<double>::digits10 + 1)
+        << reading.temperature;
+    return oss.str();
+}
+
+// Same line format as the text tier files.
+void WriteSyntheticFile(const std::filesystem::path& file, size_t lines, std::chrono::seconds step) {
+    auto start = std::chrono::system_clock::from_time_t(1700000000);
+    std::ofstream fout(file, std::ios::out | std::ios::trunc);
+    for (size_t i = 0; i < lines; i++) {
+        fout << FormatWithStreams(SyntheticReading(start, step, i)) << '\n';
+    }
+}
+
+// The loader the storage used before: getline, istringstream, get_time, timegm.
+size_t LoadWithStreams(const std::filesystem::path& file) {
+    std::deque<TReading> data;
+    std::fstream fin(file, std::ios::in);
+    std::string str;
+    while (std::getline(fin, str)) {
+        std::istringstream iss(str);
+        std::tm tm = {};
+        std::string datetime;
+        double temp;
+        iss >> datetime >> temp;
+
+        std::istringstream dtstream(datetime);
+        dtstream >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
+        tm.tm_isdst = 0;
+        data.emplace_front(std::chrono::system_clock::from_time_t(timegm(&tm)), temp);
+    }
+    return data.size();
+}
+
+// Resident and peak resident memory of the process, zero where unknown.
+struct TMemoryUsage {
+    size_t Resident = 0;
+    size_t Peak = 0;
+};
+
+TMemoryUsage GetMemoryUsage() {
+    TMemoryUsage usage;
+#ifdef __linux__
+    std::ifstream fin("/proc/self/status");
+    std::string key;
+    size_t value;
+    while (fin >> key) {
+        if (key == "VmRSS:" && fin >> value) {
+            usage.Resident = value * 1024;
+        } else if (key == "VmHWM:" && fin >> value) {
+            usage.Peak = value * 1024;
+        }
+    }
+#endif
+    return usage;
+}
+
+// Bytes passed to write calls by the process so far, zero where unknown.
+// Writes through mappings are not counted, see the on-disk size for those.
+size_t GetBytesWritten() {
+    size_t written = 0;
+#ifdef __linux__
+    std::ifstream fin("/proc/self/io");
+    std::string key;
+    size_t value;
+    while (fin >> key >> value) {
+        if (key == "wchar:") {
+            written = value;
+        }
+    }
+#endif
+    return written;
+}
+
+size_t GetDirectorySize(const std::filesystem::path& directory) {
+    size_t size = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            size += entry.file_size();
+        }
+    }
+    return size;
+}
+
+// Latencies go to a quantile sketch: a year of readings would not fit in a
+// vector without distorting the memory figures.
+nlohmann::json DescribeLatencies(const NService::TQuantileSketch& sketch) {
+    nlohmann::json result;
+    result["count"] = sketch.GetCount();
+    result["p50_us"] = sketch.GetQuantile(0.5);
+    result["p99_us"] = sketch.GetQuantile(0.99);
+    result["max_us"] = sketch.GetQuantile(1);
+    return result;
+}
+
+double MicrosecondsSince(TClock::time_point start) {
+    return std::chrono::duration<double, std::micro>(TClock::now() - start).count();
+}
+
+NConfig::TStorageConfigPtr MakeStorageConfig(
+    const std::filesystem::path& directory,
+    const std::string& backend,
+    bool writer,
+    std::chrono::milliseconds interval)
+{
+    auto config = NCommon::New<NConfig::TStorageConfig>();
+    if (backend == "column") {
+        config->ColumnStorageConfig = NCommon::New<NConfig::TColumnStorageConfig>();
+        config->ColumnStorageConfig->Path = directory;
+        return config;
+    }
+
+    auto& fileConfig = config->FileStorageConfig = NCommon::New<NConfig::TFileStorageConfig>();
+    fileConfig->TemperaturePath = directory / "raw.log";
+    fileConfig->TemperatureHourPath = directory / "hourly.log";
+    fileConfig->TemperatureDayPath = directory / "daily.log";
+    fileConfig->SampleInterval = interval;
+
+    if (backend == "segments" || backend == "journal") {
+        fileConfig->TemperaturePath = directory / "raw";
+        fileConfig->RawFormat = NConfig::ERawStorageFormat::Segments;
+    } else if (backend == "gorilla") {
+        fileConfig->FileFormat = NConfig::ETierFileFormat::Gorilla;
+    } else if (backend != "text") {
+        THROW("Unknown storage backend: {}", backend);
+    }
+
+    if (backend == "journal") {
+        fileConfig->JournalConfig = NCommon::New<NConfig::TJournalConfig>();
+        fileConfig->JournalConfig->Path = directory / "journal";
+    }
+
+    if (writer) {
+        fileConfig->WriterConfig = NCommon::New<NConfig::TStorageWriterConfig>();
+    }
+
+    return config;
+}
+
+// Random windows of the given length inside [first, last).
+nlohmann::json RunRangeQueries(
+    TTemperatureStorage& storage,
+    ETier tier,
+    std::chrono::system_clock::time_point first,
+    std::chrono::system_clock::time_point last,
+    std::chrono::seconds window,
+    size_t queries)
+{
+    std::mt19937_64 generator(42);
+    auto span = std::max<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(last - first - window).count(), 1);
+
+    NService::TQuantileSketch latencies;
+    size_t readings = 0;
+    double checksum = 0;
+    for (size_t i = 0; i < queries; i++) {
+        auto from = first + std::chrono::seconds(generator() % span);
+        auto start = TClock::now();
+        auto range = storage.GetRange(tier, from, from + window);
+        for (const auto& reading : range) {
+            checksum += reading.temperature;
+        }
+        latencies.Add(MicrosecondsSince(start));
+        readings += range.size();
+    }
+
+    auto result = DescribeLatencies(latencies);
+    result["window_seconds"] = window.count();
+    result["mean_readings"] = queries ? static_cast<double>(readings) / queries : 0.0;
+    // Keeps the summation from being optimized away.
+    result["checksum"] = checksum;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Feeds a storage backend with a synthetic stream covering the history,
+// then runs range queries against every tier.
+nlohmann::json RunIngestBenchmark(
+    const std::filesystem::path& directory,
+    const std::string& backend,
+    bool writer,
+    std::chrono::milliseconds interval,
+    size_t historyDays,
+    size_t queries)
+{
+    ASSERT(interval.count() > 0, "Reading interval must be positive");
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    auto start = std::chrono::system_clock::from_time_t(1700000000);
+    size_t readings = historyDays * 86400000 / interval.count();
+
+    nlohmann::json result;
+    result["benchmark"] = "ingest";
+    result["backend"] = backend;
+    result["writer"] = writer;
+    result["interval_ms"] = interval.count();
+    result["history_days"] = historyDays;
+    result["readings"] = readings;
+
+    auto memoryBefore = GetMemoryUsage();
+    auto writtenBefore = GetBytesWritten();
+
+    {
+        auto storage = NService::CreateStorage(MakeStorageConfig(directory, backend, writer, interval));
+
+        NService::TQuantileSketch latencies;
+        auto begin = TClock::now();
+        for (size_t i = 0; i < readings; i++) {
+            auto reading = SyntheticReading(start, interval, i);
+            auto call = TClock::now();
+            storage->ProcessTemperature(reading);
+            latencies.Add(MicrosecondsSince(call));
+        }
+        double seconds = SecondsSince(begin);
+
+        result["ingest_seconds"] = seconds;
+        result["readings_per_second"] = readings / seconds;
+        result["process_latency"] = DescribeLatencies(latencies);
+
+        auto memory = GetMemoryUsage();
+        result["memory"] = {
+            {"resident_growth_bytes", memory.Resident - std::min(memory.Resident, memoryBefore.Resident)},
+            {"peak_resident_bytes", memory.Peak},
+        };
+
+        if (readings) {
+            auto last = start + static_cast<int64_t>(readings) * interval;
+            result["queries"] = {
+                {"raw", RunRangeQueries(*storage, ETier::Raw, std::max(start, last - std::chrono::days(1)), last, std::chrono::hours(1), queries)},
+                {"hourly", RunRangeQueries(*storage, ETier::Hourly, std::max(start, last - std::chrono::days(30)), last, std::chrono::days(1), queries)},
+                {"daily", RunRangeQueries(*storage, ETier::Daily, start, last, std::chrono::days(30), queries)},
+            };
+        }
+
+        // Includes draining the writer.
+        auto close = TClock::now();
+        storage.reset();
+        result["close_seconds"] = SecondsSince(close);
+    }
+
+    result["bytes_written"] = GetBytesWritten() - writtenBefore;
+    result["disk_bytes"] = GetDirectorySize(directory);
+
+    std::filesystem::remove_all(directory);
+    return result;
+}
+
+// Several sensors ingesting at once through TShardedStorage, one thread per
+// sensor. Shards share nothing, so the total should grow with the sensors
+// until the disk or the cores run out.
+nlohmann::json RunShardedBenchmark(
+    const std::filesystem::path& directory,
+    const std::string& backend,
+    bool writer,
+    std::chrono::milliseconds interval,
+    size_t historyDays,
+    size_t sensors)
+{
+    ASSERT(interval.count() > 0, "Reading interval must be positive");
+    ASSERT(sensors > 0, "At least one sensor is required");
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    auto start = std::chrono::system_clock::from_time_t(1700000000);
+    size_t readings = historyDays * 86400000 / interval.count();
+
+    nlohmann::json result;
+    result["benchmark"] = "sharded";
+    result["backend"] = backend;
+    result["writer"] = writer;
+    result["interval_ms"] = interval.count();
+    result["history_days"] = historyDays;
+    result["sensors"] = sensors;
+    result["readings_per_sensor"] = readings;
+
+    {
+        auto config = MakeStorageConfig(directory, backend, writer, interval);
+        for (size_t index = 0; index < sensors; index++) {
+            config->Sensors.push_back("sensor-" + std::to_string(index));
+        }
+        auto storage = NService::CreateShardedStorage(config);
+
+        std::vector<double> seconds(sensors);
+        std::latch ready(sensors + 1);
+        std::vector<std::thread> threads;
+        for (size_t index = 0; index < sensors; index++) {
+            threads.emplace_back([&, index] {
+                auto& shard = storage->GetShard(config->Sensors[index]);
+                ready.arrive_and_wait();
+                auto begin = TClock::now();
+                for (size_t i = 0; i < readings; i++) {
+                    shard.ProcessTemperature(SyntheticReading(start, interval, i));
+                }
+                seconds[index] = SecondsSince(begin);
+            });
+        }
+
+        ready.arrive_and_wait();
+        auto begin = TClock::now();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double wallSeconds = SecondsSince(begin);
+
+        auto& shards = result["shards"] = nlohmann::json::array();
+        for (size_t index = 0; index < sensors; index++) {
+            ASSERT(storage->GetShard(config->Sensors[index]).GetRawReadings().size() > 0 || readings == 0,
+                "Shard {} holds no readings", config->Sensors[index]);
+            shards.push_back({
+                {"sensor", config->Sensors[index]},
+                {"ingest_seconds", seconds[index]},
+                {"readings_per_second", readings / seconds[index]},
+            });
+        }
+        result["ingest_seconds"] = wallSeconds;
+        result["readings_per_second"] = sensors * readings / wallSeconds;
+
+        // Includes draining the writers.
+        auto close = TClock::now();
+        storage.reset();
+        result["close_seconds"] = SecondsSince(close);
+    }
+
+    result["disk_bytes"] = GetDirectorySize(directory);
+
+    std::filesystem::remove_all(directory);
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Startup time of TFileStorage on synthetic text tiers: raw readings every
+// second plus the matching hourly and daily files.
+nlohmann::json RunLoadBenchmark(const std::filesystem::path& directory, size_t lines) {
+    std::filesystem::create_directories(directory);
+
+    auto config = NCommon::New<NConfig::TFileStorageConfig>();
+    config->TemperaturePath = directory / "raw.log";
+    config->TemperatureHourPath = directory / "hourly.log";
+    config->TemperatureDayPath = directory / "daily.log";
+
+    WriteSyntheticFile(config->TemperaturePath, lines, std::chrono::seconds(1));
+    WriteSyntheticFile(config->TemperatureHourPath, lines / 3600 + 1, std::chrono::hours(1));
+    WriteSyntheticFile(config->TemperatureDayPath, lines / 86400 + 1, std::chrono::days(1));
+
+    nlohmann::json result;
+    result["benchmark"] = "load";
+    result["lines"] = lines;
+    result["file_bytes"] = std::filesystem::file_size(config->TemperaturePath);
+
+    {
+        auto start = TClock::now();
+        auto loaded = LoadWithStreams(config->TemperaturePath);
+        result["stream_parser_seconds"] = SecondsSince(start);
+        ASSERT(loaded == lines, "Stream parser loaded {} of {} lines", loaded, lines);
+    }
+
+    {
+        auto start = TClock::now();
+        NService::TFileStorage storage(config);
+        result["sequential_startup_seconds"] = SecondsSince(start);
+        ASSERT(storage.GetRawReadings().size() == lines, "Storage loaded {} of {} lines", storage.GetRawReadings().size(), lines);
+    }
+
+    {
+        auto invoker = NCommon::New<NCommon::TInvoker>(NCommon::New<NCommon::TThreadPool>(3));
+        auto start = TClock::now();
+        NService::TFileStorage storage(config, invoker);
+        result["parallel_startup_seconds"] = SecondsSince(start);
+    }
+
+    result["lines_per_second"] = lines / result["sequential_startup_seconds"].get<double>();
+
+    std::filesystem::remove_all(directory);
+    return result;
+}
+
+// Serialization speed of the stream formatter versus TReadingFormatter,
+// readings every second so the date prefix cache behaves as in the raw tier.
+nlohmann::json RunFormatBenchmark(size_t lines) {
+    auto start = std::chrono::system_clock::from_time_t(1700000000);
+
+    nlohmann::json result;
+    result["benchmark"] = "format";
+    result["lines"] = lines;
+
+    size_t streamBytes = 0;
+    {
+        auto begin = TClock::now();
+        for (size_t i = 0; i < lines; i++) {
+            streamBytes += FormatWithStreams(SyntheticReading(start, std::chrono::seconds(1), i)).size() + 1;
+        }
+        result["stream_seconds"] = SecondsSince(begin);
+    }
+
+    size_t formatterBytes = 0;
+    {
+        NService::TReadingFormatter formatter;
+        char buffer[NService::TReadingFormatter::MaxLength];
+        auto begin = TClock::now();
+        for (size_t i = 0; i < lines; i++) {
+            formatterBytes += formatter.Format(SyntheticReading(start, std::chrono::seconds(1), i), buffer) - buffer + 1;
+        }
+        result["formatter_seconds"] = SecondsSince(begin);
+    }
+
+    ASSERT(streamBytes == formatterBytes, "Formatters disagree on output size ({} vs {})", streamBytes, formatterBytes);
+    result["bytes"] = formatterBytes;
+
+    // Output must stay byte-for-byte the same.
+    NService::TReadingFormatter formatter;
+    char buffer[NService::TReadingFormatter::MaxLength];
+    for (size_t i = 0; i < lines; i += 997) {
+        auto reading = SyntheticReading(start, std::chrono::seconds(7919), i);
+        std::string_view formatted(buffer, formatter.Format(reading, buffer) - buffer);
+        ASSERT(formatted == FormatWithStreams(reading), "Formatter output differs: {}", formatted);
+    }
+
+    result["speedup"] = result["stream_seconds"].get<double>() / result["formatter_seconds"].get<double>();
+    return result;
+}
+
+// Payload of value in the given layout, as the binary encoders write it.
+std::vector<uint8_t> EncodePayload(const NDecode::TBinaryPayload& payload, double value) {
+    uint64_t bits;
+    if (payload.FloatingPoint) {
+        bits = payload.Width == 4
+            ? std::bit_cast<uint32_t>(static_cast<float>(value * payload.Divisor))
+            : std::bit_cast<uint64_t>(value * payload.Divisor);
+    } else {
+        bits = static_cast<uint64_t>(std::llround(value * payload.Divisor));
+    }
+
+    std::vector<uint8_t> data(payload.Width);
+    for (size_t i = 0; i < payload.Width; i++) {
+        size_t shift = payload.BigEndian ? 8 * (payload.Width - 1 - i) : 8 * i;
+        data[i] = static_cast<uint8_t>(bits >> shift);
+    }
+    return data;
+}
+
+// STX, command, length, payload, checksum, ETX.
+void AppendBinaryFrame(std::vector<uint8_t>& stream, const std::vector<uint8_t>& payload) {
+    uint8_t length = static_cast<uint8_t>(payload.size());
+    uint8_t checksum = NDecode::TFrameReader::Command ^ length;
+    stream.push_back(NDecode::TFrameReader::STX);
+    stream.push_back(NDecode::TFrameReader::Command);
+    stream.push_back(length);
+    for (auto byte : payload) {
+        stream.push_back(byte);
+        checksum ^= byte;
+    }
+    stream.push_back(checksum);
+    stream.push_back(NDecode::TFrameReader::ETX);
+}
+
+// The binary decoders before they were specialized per layout: the layout is
+// read at run time and every frame goes through a virtual call.
+class TRuntimeBinaryDecoder {
+public:
+    explicit TRuntimeBinaryDecoder(const NDecode::TBinaryPayload& payload)
+        : Payload_(payload)
+    { }
+
+    virtual ~TRuntimeBinaryDecoder() = default;
+
+    virtual std::optional<double> Decode(std::span<const uint8_t> frame) const {
+        if (frame[2] != Payload_.Width) {
+            return std::nullopt;
+        }
+
+        uint8_t checksum = frame[1] ^ frame[2];
+        uint64_t bits = 0;
+        for (size_t i = 0; i < Payload_.Width; i++) {
+            checksum ^= frame[3 + i];
+            size_t shift = Payload_.BigEndian ? 8 * (Payload_.Width - 1 - i) : 8 * i;
+            bits |= static_cast<uint64_t>(frame[3 + i]) << shift;
+        }
+        if (checksum != frame[3 + Payload_.Width]) {
+            return std::nullopt;
+        }
+
+        if (Payload_.FloatingPoint) {
+            return Payload_.Width == 4
+                ? std::bit_cast<float>(static_cast<uint32_t>(bits)) / Payload_.Divisor
+                : std::bit_cast<double>(bits) / Payload_.Divisor;
+        }
+        if (Payload_.Signed) {
+            size_t unused = 64 - 8 * Payload_.Width;
+            return static_cast<double>(static_cast<int64_t>(bits << unused) >> unused) / Payload_.Divisor;
+        }
+        return static_cast<double>(bits) / Payload_.Divisor;
+    }
+
+private:
+    NDecode::TBinaryPayload Payload_;
+};
+
+nlohmann::json RunDecodeBenchmark(size_t frames) {
+    constexpr size_t ChunkSize = 512;
+
+    struct TFormat {
+        std::string Name;
+        NDecode::ETemperatureFormat Format;
+        NDecode::TBinaryPayload Payload;
+    };
+    const std::vector<TFormat> formats = {
+        {"byte_integer", NDecode::ETemperatureFormat::ByteInteger, NDecode::ByteIntegerPayload},
+        {"fixed_point", NDecode::ETemperatureFormat::FixedPoint, NDecode::FixedPointPayload},
+        {"floating_point", NDecode::ETemperatureFormat::FloatingPoint, NDecode::FloatingPointPayload},
+    };
+
+    auto start = std::chrono::system_clock::from_time_t(1700000000);
+
+    nlohmann::json result;
+    result["benchmark"] = "decode";
+    result["frames"] = frames;
+
+    for (const auto& format : formats) {
+        std::vector<uint8_t> stream;
+        for (size_t i = 0; i < frames; i++) {
+            AppendBinaryFrame(stream, EncodePayload(format.Payload, SyntheticReading(start, std::chrono::seconds(1), i).temperature));
+        }
+
+        double runtimeSum = 0;
+        size_t runtimeCount = 0;
+        double runtimeSeconds;
+        {
+            auto decoder = std::make_unique<TRuntimeBinaryDecoder>(format.Payload);
+            NDecode::TFrameReader reader(NDecode::EFraming::LengthPrefixed);
+            auto begin = TClock::now();
+            for (size_t position = 0; position < stream.size(); ) {
+                position += reader.Append({stream.data() + position, std::min(ChunkSize, stream.size() - position)});
+                for (auto frame = reader.Next(); !frame.empty(); frame = reader.Next()) {
+                    if (auto temperature = decoder->Decode(frame)) {
+                        runtimeSum += *temperature;
+                        runtimeCount++;
+                    }
+                }
+            }
+            runtimeSeconds = SecondsSince(begin);
+        }
+
+        double sum = 0;
+        size_t count = 0;
+        double seconds;
+        {
+            auto decoder = NDecode::CreateDecoder(format.Format);
+            std::array<NDecode::TSample, 64> samples;
+            auto begin = TClock::now();
+            for (size_t position = 0; position < stream.size(); ) {
+                position += decoder->Append({stream.data() + position, std::min(ChunkSize, stream.size() - position)});
+                while (size_t decoded = decoder->DecodeBuffered(samples)) {
+                    for (size_t i = 0; i < decoded; i++) {
+                        sum += samples[i].Temperature;
+                    }
+                    count += decoded;
+                }
+            }
+            seconds = SecondsSince(begin);
+        }
+
+        ASSERT(count == frames && runtimeCount == frames, "Frames lost ({} and {} of {})", count, runtimeCount, frames);
+        ASSERT(sum == runtimeSum, "Decoders disagree ({} vs {})", sum, runtimeSum);
+
+        auto& entry = result[format.Name];
+        entry["bytes"] = stream.size();
+        entry["runtime_seconds"] = runtimeSeconds;
+        entry["specialized_seconds"] = seconds;
+        entry["specialized_mb_per_second"] = static_cast<double>(stream.size()) / seconds / 1e6;
+        entry["speedup"] = runtimeSeconds / seconds;
+    }
+
+    return result;
+}
+
+// Gorilla codec alone: readings every second with millisecond jitter, as a
+// sensor read over a serial port delivers them. Throughput in megabytes is
+// counted over the 16 bytes a reading takes uncompressed.
+nlohmann::json RunGorillaBenchmark(size_t readings) {
+    constexpr size_t ReadingBytes = sizeof(int64_t) + sizeof(double);
+
+    auto start = std::chrono::system_clock::from_time_t(1700000000);
+    std::mt19937_64 generator(42);
+    std::vector<TReading> input;
+    input.reserve(readings);
+    for (size_t i = 0; i < readings; i++) {
+        auto reading = SyntheticReading(start, std::chrono::seconds(1), i);
+        reading.timestamp += std::chrono::milliseconds(generator() % 20);
+        input.push_back(reading);
+    }
+
+    nlohmann::json result;
+    result["benchmark"] = "gorilla";
+    result["readings"] = readings;
+
+    auto begin = TClock::now();
+    auto blocks = NService::EncodeGorillaBlocks(input);
+    double encodeSeconds = SecondsSince(begin);
+
+    size_t encodedBytes = 0;
+    for (const auto& block : blocks) {
+        encodedBytes += block.size();
+    }
+
+    std::vector<TReading> output;
+    output.reserve(readings);
+    begin = TClock::now();
+    for (const auto& block : blocks) {
+        NService::TGorillaDecoder decoder(block);
+        TReading reading;
+        while (decoder.Next(reading)) {
+            output.push_back(reading);
+        }
+    }
+    double decodeSeconds = SecondsSince(begin);
+
+    ASSERT(output.size() == input.size(), "Decoded {} of {} readings", output.size(), input.size());
+    for (size_t i = 0; i < readings; i++) {
+        ASSERT(output[i].timestamp == input[i].timestamp && output[i].temperature == input[i].temperature,
+            "Reading {} does not survive the round trip", i);
+    }
+
+    result["blocks"] = blocks.size();
+    result["encoded_bytes"] = encodedBytes;
+    result["bytes_per_sample"] = readings ? static_cast<double>(encodedBytes) / readings : 0.0;
+    result["encode"] = {
+        {"seconds", encodeSeconds},
+        {"readings_per_second", readings / encodeSeconds},
+        {"mb_per_second", static_cast<double>(readings * ReadingBytes) / encodeSeconds / 1e6},
+    };
+    result["decode"] = {
+        {"seconds", decodeSeconds},
+        {"readings_per_second", readings / decodeSeconds},
+        {"mb_per_second", static_cast<double>(readings * ReadingBytes) / decodeSeconds / 1e6},
+    };
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    NCommon::GetOpts opts;
+    opts.AddOption('h', "help", "Show help message");
+    opts.AddOption('m', "mode", "Benchmark to run: load, format, ingest, sharded, decode, gorilla", true);
+    opts.AddOption('d', "dir", "Scratch directory", true);
+    opts.AddOption('n', "lines", "Number of synthetic readings (load, format, decode, gorilla)", true);
+    opts.AddOption('b', "backend", "Storage backend for ingest and sharded: text, gorilla, segments, journal, column", true);
+    opts.AddOption('w', "writer", "Write files on a background thread (ingest, sharded)");
+    opts.AddOption('i', "interval", "Milliseconds between synthetic readings, 100 for 10 Hz (ingest, sharded)", true);
+    opts.AddOption('s', "sensors", "Sensors ingesting in parallel (sharded)", true);
+    opts.AddOption('H', "history", "Days of history to ingest", true);
+    opts.AddOption('q', "queries", "Range queries per tier (ingest)", true);
+
+    try {
+        opts.Parse(argc, argv);
+
+        if (opts.Has('h')) {
+            std::cerr << "Usage: " << argv[0] << " [OPTIONS]\n" << opts.Help();
+            return 0;
+        }
+
+        std::string mode = opts.Has('m') ? opts.Get('m') : "load";
+        std::filesystem::path directory = opts.Has('d')
+            ? std::filesystem::path(opts.Get('d'))
+            : std::filesystem::temp_directory_path() / "storage_bench";
+        size_t lines = opts.Has('n') ? std::stoul(opts.Get('n')) : 1000000;
+
+        nlohmann::json result;
+        if (mode == "load") {
+            result = RunLoadBenchmark(directory, lines);
+        } else if (mode == "format") {
+            result = RunFormatBenchmark(lines);
+        } else if (mode == "decode") {
+            result = RunDecodeBenchmark(lines);
+        } else if (mode == "gorilla") {
+            result = RunGorillaBenchmark(lines);
+        } else if (mode == "ingest") {
+            result = RunIngestBenchmark(
+                directory,
+                opts.Has('b') ? opts.Get('b') : "segments",
+                opts.Has('w'),
+                std::chrono::milliseconds(opts.Has('i') ? std::stol(opts.Get('i')) : 60000),
+                opts.Has('H') ? std::stoul(opts.Get('H')) : 1,
+                opts.Has('q') ? std::stoul(opts.Get('q')) : 1000);
+        } else if (mode == "sharded") {
+            result = RunShardedBenchmark(
+                directory,
+                opts.Has('b') ? opts.Get('b') : "segments",
+                opts.Has('w'),
+                std::chrono::milliseconds(opts.Has('i') ? std::stol(opts.Get('i')) : 60000),
+                opts.Has('H') ? std::stoul(opts.Get('H')) : 1,
+                opts.Has('s') ? std::stoul(opts.Get('s')) : 4);
+        } else {
+            THROW("Unknown benchmark mode: {}", mode);
+        }
+
+        std::cout << result.dump(4) << std::endl;
+    } catch (const std::exception& ex) {
+        LOG_ERROR("Benchmark failed: {}", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <service/column_storage.h>
+#include <service/config.h>
+#include <service/cursor.h>
+#include <service/file_storage.h>
+#include <service/sharded_storage.h>
+#include <service/text_format.h>
+
+#include <common/exception.h>
+#include <common/getopts.h>
+#include <common/logging.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+ETier ParseTier(const std::string& tier) {
+    if (tier == "raw") {
+        return ETier::Raw;
+    } else if (tier == "hourly") {
+        return ETier::Hourly;
+    } else if (tier == "daily") {
+        return ETier::Daily;
+    }
+    THROW("Unknown tier: {}", tier);
+}
+
+std::chrono::system_clock::time_point ParseTime(const NCommon::GetOpts& opts, char option, std::chrono::system_clock::time_point fallback) {
+    if (!opts.Has(option)) {
+        return fallback;
+    }
+    return std::chrono::system_clock::time_point(std::chrono::seconds(std::stoll(opts.Get(option))));
+}
+
+// Neither backend is opened for writing, the data directory stays untouched.
+NService::TReadingCursorPtr OpenCursor(
+    const NConfig::TStorageConfigPtr& config,
+    const std::string& sensorId,
+    ETier tier,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to)
+{
+    if (config->ColumnStorageConfig) {
+        auto columnConfig = sensorId.empty()
+            ? config->ColumnStorageConfig
+            : NService::MakeShardConfig(config->ColumnStorageConfig, sensorId);
+        return NService::TColumnStorage::OpenColumnCursor(*columnConfig, tier, from, to);
+    }
+
+    auto fileConfig = sensorId.empty()
+        ? config->FileStorageConfig
+        : NService::MakeShardConfig(config->FileStorageConfig, sensorId);
+    return NService::TFileStorage::OpenFileCursor(*fileConfig, tier, from, to);
+}
+
+// Lines go out in the text tier format, formatted into one reused buffer.
+size_t Export(NService::TReadingCursor& cursor, std::ostream& out) {
+    constexpr size_t ChunkSize = 64 * 1024;
+    std::vector<char> chunk(ChunkSize);
+    char* end = chunk.data();
+
+    NService::TReadingFormatter formatter;
+    size_t count = 0;
+    TReading reading;
+    while (cursor.Next(reading)) {
+        if (chunk.data() + ChunkSize - end <= static_cast<ptrdiff_t>(NService::TReadingFormatter::MaxLength)) {
+            out.write(chunk.data(), end - chunk.data());
+            end = chunk.data();
+        }
+        end = formatter.Format(reading, end);
+        *end++ = '\n';
+        count++;
+    }
+    out.write(chunk.data(), end - chunk.data());
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    NCommon::GetOpts opts;
+    opts.AddOption('h', "help", "Show help message");
+    opts.AddOption('c', "config", "Path to the service config", true);
+    opts.AddOption('s', "sensor", "Sensor id of a sharded storage", true);
+    opts.AddOption('t', "tier", "Tier to export: raw, hourly, daily", true);
+    opts.AddOption('f', "from", "First second to export (unix time)", true);
+    opts.AddOption('u', "until", "Second to stop before (unix time)", true);
+    opts.AddOption('o', "output", "Output file, stdout by default", true);
+
+    try {
+        opts.Parse(argc, argv);
+
+        if (opts.Has('h')) {
+            std::cerr << "Usage: " << argv[0] << " [OPTIONS]\n" << opts.Help();
+            return 0;
+        }
+
+        ASSERT(opts.Has('c'), "Config is required");
+        auto config = NCommon::New<NConfig::TConfig>();
+        config->LoadFromFile(opts.Get('c'));
+
+        auto cursor = OpenCursor(
+            config->StorageConfig,
+            opts.Has('s') ? opts.Get('s') : std::string(),
+            ParseTier(opts.Has('t') ? opts.Get('t') : "raw"),
+            ParseTime(opts, 'f', std::chrono::system_clock::time_point::min()),
+            ParseTime(opts, 'u', std::chrono::system_clock::time_point::max()));
+
+        size_t count;
+        if (opts.Has('o')) {
+            std::ofstream fout(opts.Get('o'), std::ios::out | std::ios::trunc);
+            count = Export(*cursor, fout);
+            ASSERT(fout.flush(), "Failed to write {}", opts.Get('o'));
+        } else {
+            count = Export(*cursor, std::cout);
+            std::cout.flush();
+        }
+
+        LOG_INFO("Readings exported (Count: {})", count);
+    } catch (const std::exception& ex) {
+        LOG_ERROR("Export failed: {}", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
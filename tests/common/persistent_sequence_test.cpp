@@ -0,0 +1,232 @@
+#include <common/exception.h>
+#include <common/persistent_sequence.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Small chunks, so that a few items already span many of them.
+constexpr size_t ChunkSize = 4;
+
+// Items are default-constructed only when a chunk is allocated, reused
+// chunks keep theirs.
+struct TItem {
+    static inline size_t Constructed = 0;
+
+    int Value = 0;
+
+    TItem() { Constructed++; }
+    TItem(int value) : Value(value) { }
+};
+
+struct TSumSummary {
+    int Sum = 0;
+    size_t Count = 0;
+
+    void Add(const TItem& item) {
+        Sum += item.Value;
+        Count++;
+    }
+};
+
+using TSequence = NCommon::TPersistentSequence<TItem, ChunkSize, TSumSummary>;
+
+size_t GetAllocatedChunks() {
+    return TItem::Constructed / ChunkSize;
+}
+
+TSequence MakeSequence(int from, int to) {
+    TSequence sequence;
+    for (int value = from; value < to; value++) {
+        sequence.push_back(value);
+    }
+    return sequence;
+}
+
+std::vector<int> ToVector(const TSequence& sequence) {
+    std::vector<int> values;
+    for (const auto& item : sequence) {
+        values.push_back(item.Value);
+    }
+    return values;
+}
+
+std::vector<int> Range(int from, int to) {
+    std::vector<int> values;
+    for (int value = from; value < to; value++) {
+        values.push_back(value);
+    }
+    return values;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestSnapshotStability() {
+    auto sequence = MakeSequence(0, 100);
+    auto snapshot = sequence;
+
+    sequence.push_back(100);
+    sequence.pop_front();
+    sequence.truncate(50);
+    sequence.insert(sequence.begin() + 10, -1);
+    sequence.replace(sequence.begin() + 20, -2);
+    sequence.push_back(-3);
+
+    ASSERT(ToVector(snapshot) == Range(0, 100), "Snapshot changed by edits of the newest version");
+
+    auto expected = Range(1, 51);
+    expected.insert(expected.begin() + 10, -1);
+    expected[20] = -2;
+    expected.push_back(-3);
+    ASSERT(ToVector(sequence) == expected, "Edits are not applied");
+}
+
+void TestBranching() {
+    auto base = MakeSequence(0, 10);
+    auto left = base;
+    auto right = base;
+
+    // Both append to slot 10 of the same chunk, the second one detaches.
+    left.push_back(100);
+    right.push_back(200);
+    ASSERT(left.back().Value == 100 && left.size() == 11, "Left branch lost its item");
+    ASSERT(right.back().Value == 200 && right.size() == 11, "Right branch lost its item");
+    ASSERT(ToVector(base) == Range(0, 10), "Base changed by its branches");
+
+    // A version behind the newest one grows without clobbering it.
+    auto old = left;
+    left.push_back(101);
+    old.push_back(300);
+    ASSERT(left.back().Value == 101 && left[10].Value == 100, "Newest version changed by an older one");
+    ASSERT(old.back().Value == 300 && old.size() == 12, "Older version did not branch");
+
+    // Truncating and growing again leaves the snapshot of the longer version.
+    auto longer = MakeSequence(0, 20);
+    auto shorter = longer;
+    shorter.truncate(5);
+    shorter.push_back(-1);
+    ASSERT(ToVector(longer) == Range(0, 20), "Longer version changed by a truncated one");
+    ASSERT(shorter.size() == 6 && shorter.back().Value == -1, "Truncated version did not grow");
+}
+
+void TestRebase() {
+    TSequence sequence;
+    int next = 0;
+    int first = 0;
+    // Popping far past the first spine makes appends rebuild and rebase it.
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < 7; i++) {
+            sequence.push_back(next++);
+        }
+        for (int i = 0; i < 5; i++) {
+            sequence.pop_front();
+            first++;
+        }
+        ASSERT(sequence.front().Value == first && sequence.back().Value == next - 1,
+            "Wrong bounds after rebase (Round: {})", round);
+    }
+    ASSERT(ToVector(sequence) == Range(first, next), "Wrong items after rebase");
+
+    auto snapshot = sequence;
+    sequence.reserve(1000);
+    for (int i = 0; i < 1000; i++) {
+        sequence.push_back(next++);
+        sequence.pop_front();
+    }
+    ASSERT(ToVector(snapshot) == Range(first, first + static_cast<int>(snapshot.size())), "Snapshot changed by a rebase");
+}
+
+void TestChunkRecycling() {
+    constexpr int Window = 64;
+    auto sequence = MakeSequence(0, Window);
+    int next = Window;
+    auto slide = [&] (int count) {
+        for (int i = 0; i < count; i++) {
+            sequence.pop_front();
+            sequence.push_back(next++);
+        }
+    };
+
+    slide(10000);
+    auto warm = GetAllocatedChunks();
+    slide(10000);
+    ASSERT(GetAllocatedChunks() == warm, "Sliding window keeps allocating ({} -> {} chunks)", warm, GetAllocatedChunks());
+
+    // Chunks a snapshot holds are not reused while it lives.
+    {
+        auto snapshot = sequence;
+        auto expected = ToVector(snapshot);
+        slide(10000);
+        ASSERT(ToVector(snapshot) == expected, "Chunk of a live snapshot was recycled");
+        ASSERT(GetAllocatedChunks() > warm, "Held chunks were not replaced");
+    }
+
+    slide(10000);
+    warm = GetAllocatedChunks();
+    slide(10000);
+    ASSERT(GetAllocatedChunks() == warm, "Released chunks are not reused");
+    ASSERT(ToVector(sequence) == Range(next - Window, next), "Wrong items after recycling");
+}
+
+void TestChunkSummary() {
+    auto sequence = MakeSequence(0, 10);
+
+    // Chunks [0, 4) and [4, 8) are full, [8, 10) is not.
+    auto* summary = sequence.GetChunkSummary(5);
+    ASSERT(summary && summary->Count == 4 && summary->Sum == 4 + 5 + 6 + 7, "Wrong summary of a full chunk");
+    ASSERT(sequence.GetChunkEnd(5) == 8, "Wrong end of a full chunk");
+    ASSERT(!sequence.GetChunkSummary(9), "Summary of a partial chunk");
+    ASSERT(sequence.GetChunkEnd(9) == 10, "Wrong end of the last chunk");
+
+    // The summary still covers items popped from the front.
+    sequence.pop_front();
+    summary = sequence.GetChunkSummary(0);
+    ASSERT(summary && summary->Count == 4 && summary->Sum == 0 + 1 + 2 + 3, "Summary lost popped items");
+    ASSERT(sequence.GetChunkEnd(0) == 3, "Wrong end of the first chunk");
+
+    // A version that lacks the end of a chunk does not get its summary.
+    auto truncated = sequence;
+    truncated.truncate(5);
+    ASSERT(!truncated.GetChunkSummary(4), "Summary of a chunk cut by truncate");
+    ASSERT(sequence.GetChunkSummary(4), "Truncating a copy changed the original");
+
+    // Detached copies rebuild the summary from their own items.
+    truncated.push_back(100);
+    truncated.push_back(200);
+    summary = truncated.GetChunkSummary(4);
+    ASSERT(summary && summary->Count == 4 && summary->Sum == 4 + 5 + 100 + 200, "Wrong summary of a detached chunk");
+    summary = sequence.GetChunkSummary(4);
+    ASSERT(summary && summary->Sum == 4 + 5 + 6 + 7, "Detaching changed the summary of the original");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+} // namespace
+
+int main() {
+    const std::vector<std::pair<std::string, std::function<void()>>> tests = {
+        {"SnapshotStability", TestSnapshotStability},
+        {"Branching", TestBranching},
+        {"Rebase", TestRebase},
+        {"ChunkRecycling", TestChunkRecycling},
+        {"ChunkSummary", TestChunkSummary},
+    };
+
+    int failed = 0;
+    for (const auto& [name, test] : tests) {
+        try {
+            test();
+            std::cout << "[ OK ] " << name << std::endl;
+        } catch (const std::exception& ex) {
+            std::cout << "[FAIL] " << name << ": " << ex.what() << std::endl;
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}